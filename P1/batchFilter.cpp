@@ -0,0 +1,767 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "filters.h"
+#include "exec.h"
+#include "live.h"
+#include "bufferPool.h"
+#include "planar.h"
+#include "filterGraph.h"
+#include "blur.h"
+#include "yuv.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// the number of frames each ring between two stages holds
+#define BATCH_RING_SIZE 4
+
+// how long a stage waits on an empty ring before checking whether to stop
+#define POP_TIMEOUT_MS 10
+
+#define DEFAULT_LEVELS 15
+#define DEFAULT_MAG_THRESHOLD 15
+#define DEFAULT_ORIENTATION_BINS 8
+
+// the grid cell of the bilateral cartoon, in pixels and in luma levels
+#define DEFAULT_SIGMA_SPACE 16
+#define DEFAULT_SIGMA_RANGE 16
+
+// the box radius of box and the sigma of gaussian, in pixels
+#define DEFAULT_BOX_RADIUS 8
+#define DEFAULT_BLUR_SIGMA 8.0
+
+// the frame rate written when the input does not report one
+#define DEFAULT_FPS 30
+
+typedef live::Clock Clock;
+
+// A filter selected on the command line, with its parameters
+struct BatchFilter
+{
+    // the name of the filter
+    std::string name;
+
+    // quantization levels for quantize, cartoon and bilateral
+    int levels = DEFAULT_LEVELS;
+
+    // magnitude threshold for cartoon and bilateral
+    int threshold = DEFAULT_MAG_THRESHOLD;
+
+    // spatial sigma for bilateral
+    int sigma_space = DEFAULT_SIGMA_SPACE;
+
+    // box radius for box
+    int radius = DEFAULT_BOX_RADIUS;
+
+    // standard deviation for gaussian
+    double sigma = DEFAULT_BLUR_SIGMA;
+
+    // direction bins for orientation
+    int bins = DEFAULT_ORIENTATION_BINS;
+
+    // run the filter on planar channels, splitting and merging each frame once
+    bool planar = false;
+
+    // find the edges of magnitude and cartoon on luma alone rather than per channel
+    bool luma = false;
+
+    // the operations of a chain, e.g. "blur,sobelx,abs"
+    std::string chain;
+};
+
+// Where the frames come from and where the filtered frames go
+struct BatchIO
+{
+    // is the input a directory of images rather than a video file
+    bool is_dir = false;
+
+    // the input images, in order, when the input is a directory
+    std::vector<std::string> files;
+
+    // the input video, when the input is a video file
+    cv::VideoCapture cap;
+
+    // is the input a raw file of back to back YUV frames
+    bool is_yuv = false;
+
+    // the raw YUV input, its frame size and its format
+    std::ifstream yuv_file;
+    cv::Size yuv_size;
+    yuv::Format yuv_format = yuv::FORMAT_I420;
+
+    // the output directory or video file
+    std::string output;
+
+    // the output video, opened on the first filtered frame
+    cv::VideoWriter writer;
+
+    // the frame rate of the output video
+    double fps = DEFAULT_FPS;
+};
+
+// The time each stage spent working, excluding waits on the rings. Each field is
+// only written by its own stage's thread.
+struct StageTimes
+{
+    double decode_ms = 0;
+    double filter_ms = 0;
+    double encode_ms = 0;
+};
+
+double elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void print_usage()
+{
+    printf("usage: BatchFilter [-t n_threads] [-p] [-l] [-y WxH:format] <input> <output> <filter> [params...]\n");
+    printf("  input   a directory of images or a video file, or with -y a raw file of\n");
+    printf("          i420, nv12, yuyv or uyvy frames\n");
+    printf("  output  a directory for image input, a video file for video input\n");
+    printf("  filters grayscale, blur, sobelx, sobely, magnitude, negative,\n");
+    printf("          orientation [bins], quantize [levels], cartoon [levels] [threshold],\n");
+    printf("          bilateral [levels] [threshold] [sigma_space], box [radius], gaussian [sigma],\n");
+    printf("          chain <op,op,...> of grayscale, blur, sobelx, sobely, abs, magnitude,\n");
+    printf("          negative, orientation[:bins] and quantize[:levels]\n");
+}
+
+bool parse_filter(int argc, char *argv[], BatchFilter *filter)
+{
+    const char *names[] = {
+        "grayscale", "blur", "sobelx", "sobely", "magnitude", "negative", "orientation",
+        "quantize", "cartoon", "bilateral", "box", "gaussian", "chain"};
+
+    bool known = false;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        known = known || filter->name == names[i];
+    }
+    if (!known)
+    {
+        printf("Unknown filter: %s\n", filter->name.c_str());
+        return false;
+    }
+
+    int max_params = filter->name == "cartoon" ? 2 : filter->name == "quantize" || filter->name == "orientation" ? 1 : 0;
+    if (filter->name == "box" || filter->name == "gaussian")
+    {
+        max_params = 1;
+    }
+    if (filter->name == "chain")
+    {
+        max_params = 1;
+    }
+    if (filter->name == "bilateral")
+    {
+        max_params = 3;
+    }
+    if (argc > max_params)
+    {
+        printf("Too many parameters for %s\n", filter->name.c_str());
+        return false;
+    }
+    if (filter->name == "chain")
+    {
+        if (argc < 1)
+        {
+            printf("Chain needs a list of operations\n");
+            return false;
+        }
+        if (filter->planar)
+        {
+            printf("Chain has no planar mode\n");
+            return false;
+        }
+        filter->chain = argv[0];
+        return true;
+    }
+    if (filter->name == "orientation")
+    {
+        filter->bins = argc > 0 ? atoi(argv[0]) : filter->bins;
+        if (filter->bins < 2 || filter->bins > 255)
+        {
+            printf("Bins must be between 2 and 255\n");
+            return false;
+        }
+        return true;
+    }
+    if (filter->name == "box" || filter->name == "gaussian")
+    {
+        if (filter->planar)
+        {
+            printf("%s has no planar mode\n", filter->name.c_str());
+            return false;
+        }
+        if (filter->name == "box")
+        {
+            filter->radius = argc > 0 ? atoi(argv[0]) : filter->radius;
+            if (filter->radius < 0 || filter->radius > 4096)
+            {
+                printf("Radius must be between 0 and 4096\n");
+                return false;
+            }
+            return true;
+        }
+        filter->sigma = argc > 0 ? atof(argv[0]) : filter->sigma;
+        if (!(filter->sigma >= 0.5 && filter->sigma <= 256))
+        {
+            printf("Sigma must be between 0.5 and 256\n");
+            return false;
+        }
+        return true;
+    }
+    if (argc > 0)
+    {
+        filter->levels = atoi(argv[0]);
+    }
+    if (argc > 1)
+    {
+        filter->threshold = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        filter->sigma_space = atoi(argv[2]);
+    }
+    if (filter->name == "bilateral" && (filter->sigma_space < 2 || filter->sigma_space > 256))
+    {
+        printf("Sigma space must be between 2 and 256\n");
+        return false;
+    }
+    if (filter->name == "bilateral" && filter->planar)
+    {
+        printf("Bilateral has no planar mode\n");
+        return false;
+    }
+    if (filter->luma && filter->planar)
+    {
+        printf("Luma gradients have no planar mode\n");
+        return false;
+    }
+    if (filter->levels < 1 || filter->levels > 255)
+    {
+        printf("Levels must be between 1 and 255\n");
+        return false;
+    }
+
+    return true;
+}
+
+void apply_filter(const BatchFilter &filter, graph::FilterGraph *chain, cv::Mat &frame, cv::Mat &dst)
+{
+    if (filter.name == "chain")
+    {
+        chain->run(frame, dst);
+    }
+    else if (filter.name == "grayscale")
+    {
+        grayscale(&frame, &dst);
+    }
+    else if (filter.name == "blur")
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        blur5x5(frame, dst);
+    }
+    else if (filter.name == "sobelx" || filter.name == "sobely")
+    {
+        pool::PooledMat img(frame.rows, frame.cols, CV_16SC(frame.channels()));
+        sobel(&frame, img.get(), filter.name == "sobelx" ? 'x' : 'y');
+        dst.create(frame.rows, frame.cols, frame.type());
+        convertToUchar(img.get(), &dst);
+    }
+    else if (filter.name == "magnitude" && filter.luma)
+    {
+        magnitudeLuma(frame, dst);
+    }
+    else if (filter.name == "magnitude")
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        magnitudeFilter(&frame, &dst);
+    }
+    else if (filter.name == "negative")
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        negative(frame, dst);
+    }
+    else if (filter.name == "orientation")
+    {
+        orientation(&frame, &dst, filter.bins);
+    }
+    else if (filter.name == "quantize")
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        blurQuantize(frame, dst, filter.levels);
+    }
+    else if (filter.name == "cartoon" && filter.luma)
+    {
+        cartoonLuma(frame, dst, filter.levels, filter.threshold);
+    }
+    else if (filter.name == "cartoon")
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        cartoon(frame, dst, filter.levels, filter.threshold);
+    }
+    else if (filter.name == "bilateral")
+    {
+        cartoonBilateral(frame, dst, filter.levels, filter.threshold, filter.sigma_space, DEFAULT_SIGMA_RANGE);
+    }
+    else if (filter.name == "box")
+    {
+        blur::boxBlur(frame, dst, filter.radius);
+    }
+    else if (filter.name == "gaussian")
+    {
+        blur::recursiveGaussian(frame, dst, filter.sigma);
+    }
+}
+
+// applies a filter which only reads luma straight to a YUV frame, returning false
+// for the filters which need the frame in BGR
+bool apply_filter_yuv(const BatchFilter &filter, yuv::Format format, cv::Mat &frame, cv::Mat &dst)
+{
+    if (filter.name == "grayscale")
+    {
+        // the Y plane is a view of the decoded frame, which goes back to the ring on
+        // the next pop, so it is copied out
+        cv::Mat y;
+        yuv::grayscale(frame, format, y);
+        y.copyTo(dst);
+        return true;
+    }
+    if (filter.name == "sobelx" || filter.name == "sobely")
+    {
+        pool::PooledMat img(frame.rows, frame.cols, CV_16SC1);
+        if (filter.name == "sobelx")
+        {
+            yuv::sobelX3x3(frame, format, *img);
+        }
+        else
+        {
+            yuv::sobelY3x3(frame, format, *img);
+        }
+        dst.create((*img).rows, (*img).cols, CV_8UC1);
+        convertToUchar(img.get(), &dst);
+        return true;
+    }
+    if (filter.name == "magnitude")
+    {
+        yuv::magnitudeFilter(frame, format, dst);
+        return true;
+    }
+
+    return false;
+}
+
+void apply_filter_planar(
+    const BatchFilter &filter, cv::Mat &frame,
+    planar::Planes &in, planar::Planes &responses, planar::Planes &out, cv::Mat &dst)
+{
+    planar::split(frame, in);
+    if (filter.name == "grayscale")
+    {
+        planar::grayscale(in, dst);
+        return;
+    }
+    if (filter.name == "orientation")
+    {
+        planar::orientation(in, dst, filter.bins);
+        return;
+    }
+
+    if (filter.name == "blur")
+    {
+        planar::blur5x5(in, out);
+    }
+    else if (filter.name == "sobelx" || filter.name == "sobely")
+    {
+        if (filter.name == "sobelx")
+        {
+            planar::sobelX3x3(in, responses);
+        }
+        else
+        {
+            planar::sobelY3x3(in, responses);
+        }
+        planar::convertToUchar(responses, out);
+    }
+    else if (filter.name == "magnitude")
+    {
+        planar::magnitudeFilter(in, out);
+    }
+    else if (filter.name == "negative")
+    {
+        planar::negative(in, out);
+    }
+    else if (filter.name == "quantize")
+    {
+        planar::blurQuantize(in, out, filter.levels);
+    }
+    else if (filter.name == "cartoon")
+    {
+        planar::cartoon(in, out, filter.levels, filter.threshold);
+    }
+    planar::merge(out, dst);
+}
+
+bool open_input(const char *input, BatchIO *io)
+{
+    if (io->is_yuv)
+    {
+        io->yuv_file.open(input, std::ios::binary);
+        if (!io->yuv_file.is_open())
+        {
+            printf("Failed to open raw YUV file %s\n", input);
+            return false;
+        }
+        return true;
+    }
+
+    struct stat info;
+    if (stat(input, &info) != 0)
+    {
+        printf("Input not found: %s\n", input);
+        return false;
+    }
+
+    io->is_dir = S_ISDIR(info.st_mode);
+    if (io->is_dir)
+    {
+        // cv::glob returns the paths sorted, so frames keep the directory order
+        cv::glob(std::string(input) + "/*", io->files, false);
+        if (io->files.empty())
+        {
+            printf("No files in %s\n", input);
+            return false;
+        }
+        return true;
+    }
+
+    io->cap.open(input);
+    if (!io->cap.isOpened())
+    {
+        printf("Failed to open video %s\n", input);
+        return false;
+    }
+
+    double fps = io->cap.get(cv::CAP_PROP_FPS);
+    if (fps > 0)
+    {
+        io->fps = fps;
+    }
+
+    return true;
+}
+
+bool write_frame(BatchIO *io, const std::string &name, cv::Mat &frame)
+{
+    if (io->is_dir)
+    {
+        return cv::imwrite(io->output + "/" + name, frame);
+    }
+
+    // the writer is opened for colour, so single channel outputs are expanded
+    pool::PooledMat pooled_bgr(frame.rows, frame.cols, CV_8UC3);
+    cv::Mat &bgr = *pooled_bgr;
+    if (frame.channels() == 1)
+    {
+        cv::cvtColor(frame, bgr, cv::COLOR_GRAY2BGR);
+    }
+    else
+    {
+        frame.copyTo(bgr);
+    }
+
+    if (!io->writer.isOpened())
+    {
+        bool mp4 = io->output.size() > 4 && io->output.compare(io->output.size() - 4, 4, ".mp4") == 0;
+        int fourcc = mp4 ? cv::VideoWriter::fourcc('m', 'p', '4', 'v') : cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+        if (!io->writer.open(io->output, fourcc, io->fps, bgr.size(), true))
+        {
+            printf("Failed to open output video %s\n", io->output.c_str());
+            return false;
+        }
+    }
+
+    io->writer.write(bgr);
+    return true;
+}
+
+// decode stage: reads every input frame into the decoded ring
+void decode_loop(BatchIO *io, live::FrameRing *decoded, std::atomic<bool> *running, double *decode_ms)
+{
+    cv::Mat frame;
+    for (long seq = 0; *running; seq++)
+    {
+        Clock::time_point start = Clock::now();
+        if (io->is_dir)
+        {
+            if (seq == (long) io->files.size())
+            {
+                break;
+            }
+            frame = cv::imread(io->files[seq], cv::IMREAD_COLOR);
+            if (frame.empty())
+            {
+                printf("Skipping %s, not an image\n", io->files[seq].c_str());
+            }
+        }
+        else if (io->is_yuv)
+        {
+            cv::Size buffer_size;
+            int type;
+            yuv::bufferLayout(io->yuv_format, io->yuv_size, &buffer_size, &type);
+            frame.create(buffer_size, type);
+            size_t bytes = frame.total() * frame.elemSize();
+            if (!io->yuv_file.read((char *) frame.data, bytes))
+            {
+                break;
+            }
+        }
+        else
+        {
+            io->cap >> frame;
+            if (frame.empty())
+            {
+                break;
+            }
+        }
+        *decode_ms += elapsed_ms(start);
+
+        // skipped files still go through as empty frames so each sequence number
+        // keeps naming its own file
+        decoded->push(frame, seq, Clock::now());
+    }
+
+    decoded->close();
+}
+
+// filter stage: applies the filter to every decoded frame
+void filter_loop(
+    const BatchFilter *filter, graph::FilterGraph *chain, BatchIO *io, live::FrameRing *decoded, live::FrameRing *filtered,
+    std::atomic<bool> *running, double *filter_ms)
+{
+    live::Frame in;
+    cv::Mat out;
+    cv::Mat bgr;
+
+    // the planes are kept across frames so they are only allocated once
+    planar::Planes in_planes;
+    planar::Planes sobel_planes;
+    planar::Planes out_planes;
+    while (*running && !decoded->finished())
+    {
+        if (!decoded->pop(in, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+        {
+            continue;
+        }
+
+        if (in.img.empty())
+        {
+            filtered->push(in.img, in.seq, in.captured);
+            continue;
+        }
+
+        Clock::time_point start = Clock::now();
+        if (!io->is_yuv || !apply_filter_yuv(*filter, io->yuv_format, in.img, out))
+        {
+            // the filters which need color see a YUV frame converted to BGR
+            cv::Mat *frame = &in.img;
+            if (io->is_yuv)
+            {
+                yuv::toBgr(in.img, io->yuv_format, bgr);
+                frame = &bgr;
+            }
+
+            if (filter->planar)
+            {
+                apply_filter_planar(*filter, *frame, in_planes, sobel_planes, out_planes, out);
+            }
+            else
+            {
+                apply_filter(*filter, chain, *frame, out);
+            }
+        }
+        *filter_ms += elapsed_ms(start);
+
+        filtered->push(out, in.seq, in.captured);
+    }
+
+    filtered->close();
+}
+
+void print_stage(const char *name, double total_ms, long frames)
+{
+    printf("  %-8s %10.1f ms  %8.2f ms/frame\n", name, total_ms, frames > 0 ? total_ms / frames : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    int n_threads = 0;
+    bool planar_mode = false;
+    bool luma_mode = false;
+    BatchIO io;
+    std::vector<char *> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc && isdigit(argv[i + 1][0]))
+        {
+            n_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            planar_mode = true;
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            luma_mode = true;
+        }
+        else if (strcmp(argv[i], "-y") == 0 && i + 1 < argc)
+        {
+            // raw YUV input, whose frames carry no size or format of their own
+            char format[16] = "";
+            cv::Size buffer_size;
+            int type;
+            io.is_yuv = true;
+            if (sscanf(argv[++i], "%dx%d:%15s", &io.yuv_size.width, &io.yuv_size.height, format) != 3 ||
+                yuv::parseFormat(format, &io.yuv_format) != SUCCESS_CODE ||
+                yuv::bufferLayout(io.yuv_format, io.yuv_size, &buffer_size, &type) != SUCCESS_CODE)
+            {
+                printf("Invalid YUV layout %s, expected an even WxH and i420, nv12, yuyv or uyvy\n", argv[i]);
+                print_usage();
+                return ERROR_CODE;
+            }
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (args.size() < 3)
+    {
+        print_usage();
+        return ERROR_CODE;
+    }
+
+    BatchFilter filter;
+    filter.name = args[2];
+    filter.planar = planar_mode;
+    filter.luma = luma_mode;
+    if (!parse_filter((int) args.size() - 3, args.data() + 3, &filter))
+    {
+        print_usage();
+        return ERROR_CODE;
+    }
+
+    // the chain is planned once and its plan kept across frames
+    graph::FilterGraph chain;
+    if (filter.name == "chain" && (graph::parseChain(filter.chain, chain) != SUCCESS_CODE || chain.validate(CV_8UC3) != SUCCESS_CODE))
+    {
+        printf("Invalid chain: %s\n", filter.chain.c_str());
+        print_usage();
+        return ERROR_CODE;
+    }
+
+    io.output = args[1];
+    if (!open_input(args[0], &io))
+    {
+        return ERROR_CODE;
+    }
+    if (io.is_dir)
+    {
+        mkdir(io.output.c_str(), 0755);
+    }
+
+    // defaults to one filter thread per hardware thread
+    exec::setThreads(n_threads);
+    printf("Filter threads: %d\n", exec::threads());
+
+    // the rings block instead of dropping, so every input frame is written
+    cv::Size size(
+        (int) io.cap.get(cv::CAP_PROP_FRAME_WIDTH),
+        (int) io.cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    cv::Size decoded_size = size;
+    int decoded_type = CV_8UC3;
+    if (io.is_yuv)
+    {
+        size = io.yuv_size;
+        yuv::bufferLayout(io.yuv_format, io.yuv_size, &decoded_size, &decoded_type);
+    }
+    live::FrameRing decoded(BATCH_RING_SIZE, decoded_size, decoded_type, false);
+    live::FrameRing filtered(BATCH_RING_SIZE, size, CV_8UC3, false);
+    std::atomic<bool> running(true);
+    StageTimes times;
+
+    Clock::time_point start = Clock::now();
+    std::thread decode_thread(decode_loop, &io, &decoded, &running, &times.decode_ms);
+    std::thread filter_thread(filter_loop, &filter, &chain, &io, &decoded, &filtered, &running, &times.filter_ms);
+
+    // the encode stage runs on the main thread
+    long frames = 0;
+    long failed = 0;
+    live::Frame frame;
+    while (running && !filtered.finished())
+    {
+        if (!filtered.pop(frame, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+        {
+            continue;
+        }
+        if (frame.img.empty())
+        {
+            continue;
+        }
+
+        Clock::time_point encode_start = Clock::now();
+        std::string name = io.is_dir ? io.files[frame.seq].substr(io.files[frame.seq].find_last_of("/\\") + 1) : "";
+        if (write_frame(&io, name, frame.img))
+        {
+            frames++;
+        }
+        else if (!io.is_dir)
+        {
+            // nothing more can be written once the output video fails to open
+            running = false;
+            failed++;
+        }
+        else
+        {
+            printf("Failed to write %s\n", name.c_str());
+            failed++;
+        }
+        times.encode_ms += elapsed_ms(encode_start);
+    }
+
+    running = false;
+    decoded.close();
+    filtered.close();
+    decode_thread.join();
+    filter_thread.join();
+    io.writer.release();
+
+    double wall_s = elapsed_ms(start) / 1000;
+    printf("Filter: %s%s\n", filter.name.c_str(), filter.planar ? " (planar)" : "");
+    printf("Frames: %ld written, %ld failed in %.2f s (%.1f fps)\n", frames, failed, wall_s, wall_s > 0 ? frames / wall_s : 0);
+    printf("Stage time:\n");
+    print_stage("decode", times.decode_ms, frames);
+    print_stage("filter", times.filter_ms, frames);
+    print_stage("encode", times.encode_ms, frames);
+    if (filter.name == "chain")
+    {
+        printf("Fusions:\n");
+        for (size_t i = 0; i < chain.fusions().size(); i++)
+        {
+            printf("  %s\n", chain.fusions()[i].c_str());
+        }
+    }
+
+    return failed > 0 ? ERROR_CODE : SUCCESS_CODE;
+}
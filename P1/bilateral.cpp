@@ -0,0 +1,258 @@
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "bilateral.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// the number of [1, 2, 1] passes along each axis of the grid
+#define GRID_BLUR_PASSES 2
+
+namespace bilateral
+{
+    // the luma of a pixel with the weights cvtColor uses for BGR to gray
+    template <int CN>
+    static inline int luma(const uchar *px)
+    {
+        if (CN == 1)
+        {
+            return px[0];
+        }
+        return (px[0] * 1868 + px[1] * 9617 + px[2] * 4899 + 8192) >> 14;
+    }
+
+    /**
+     * A grid of cells, each holding the sum of the CN channels of the pixels splatted
+     * into it and their count. One cell of padding on every side lets the blur and
+     * the slice read neighbours without bounds checks.
+     */
+    template <int CN>
+    struct Grid
+    {
+        static constexpr int CELL = CN + 1;
+
+        // the number of cells along y, x and luma, padding included
+        int h, w, d;
+
+        // the cells, luma fastest, then x, then y
+        std::vector<float> cells;
+
+        // pixels round to the nearest cell, so the last pixel can land one cell past
+        // (rows - 1) / ss
+        Grid(int rows, int cols, int ss, int sr):
+            h((rows - 1) / ss + 4),
+            w((cols - 1) / ss + 4),
+            d(255 / sr + 4),
+            cells((size_t) h * w * d * CELL, 0.0f)
+        {}
+
+        inline float* at(int y, int x, int z) { return &cells[(((size_t) y * w + x) * d + z) * CELL]; }
+    };
+
+    // [1, 2, 1] / 4 along one line of cells, stride floats apart
+    template <int CN>
+    static void blurLine(float *line, int len, size_t stride, std::vector<float> &tmp)
+    {
+        const int cell = CN + 1;
+        tmp.resize((size_t) len * cell);
+        for (int i = 0; i < len; i++)
+        {
+            for (int k = 0; k < cell; k++)
+            {
+                tmp[i * cell + k] = line[i * stride + k];
+            }
+        }
+
+        // the padding cells stay empty, so the ends need no special case
+        for (int i = 1; i < len - 1; i++)
+        {
+            for (int k = 0; k < cell; k++)
+            {
+                line[i * stride + k] = 0.25f * (tmp[(i - 1) * cell + k] + 2 * tmp[i * cell + k] + tmp[(i + 1) * cell + k]);
+            }
+        }
+    }
+
+    template <int CN>
+    static void blurGrid(Grid<CN> &g)
+    {
+        const size_t cell = CN + 1;
+
+        // along luma and x, each y plane on its own
+        exec::forEachBand(g.h, [&](int y_begin, int y_end) {
+            std::vector<float> tmp;
+            for (int y = y_begin; y < y_end; y++)
+            {
+                for (int x = 0; x < g.w; x++)
+                {
+                    blurLine<CN>(g.at(y, x, 0), g.d, cell, tmp);
+                }
+                for (int z = 0; z < g.d; z++)
+                {
+                    blurLine<CN>(g.at(y, 0, z), g.w, g.d * cell, tmp);
+                }
+            }
+        });
+
+        // along y, each x column on its own
+        exec::forEachBand(g.w, [&](int x_begin, int x_end) {
+            std::vector<float> tmp;
+            for (int x = x_begin; x < x_end; x++)
+            {
+                for (int z = 0; z < g.d; z++)
+                {
+                    blurLine<CN>(g.at(0, x, z), g.h, (size_t) g.w * g.d * cell, tmp);
+                }
+            }
+        });
+    }
+
+    // adds the pixels of the image rows nearest to grid rows [y_begin, y_end) into
+    // the grid, so bands of grid rows never write the same cell
+    template <int CN>
+    static void splatRows(cv::Mat &src, Grid<CN> &g, int ss, int sr, int y_begin, int y_end)
+    {
+        int row_begin = std::max(0, (y_begin - 1) * ss - ss / 2);
+        int row_end = std::min(src.rows, (y_end - 1) * ss - ss / 2);
+        for (int r = row_begin; r < row_end; r++)
+        {
+            int y = (r + ss / 2) / ss + 1;
+            const uchar *srow = src.ptr<uchar>(r);
+            for (int c = 0; c < src.cols; c++)
+            {
+                const uchar *px = srow + c * CN;
+                float *cell = g.at(y, (c + ss / 2) / ss + 1, (luma<CN>(px) + sr / 2) / sr + 1);
+                for (int k = 0; k < CN; k++)
+                {
+                    cell[k] += px[k];
+                }
+                cell[CN] += 1;
+            }
+        }
+    }
+
+    // reads the smoothed color of each pixel of rows [row_begin, row_end) back out of
+    // the grid by trilinear interpolation. The two grid rows around an image row are
+    // blended once per row, leaving a bilinear lookup in x and luma per pixel.
+    template <int CN>
+    static void sliceRows(
+        cv::Mat &src, cv::Mat &dst, Grid<CN> &g, int ss, int sr,
+        const std::vector<int> &col_cell, const std::vector<float> &col_frac, int row_begin, int row_end)
+    {
+        const int cell = CN + 1;
+        const size_t dx = (size_t) g.d * cell;
+        const size_t plane_size = (size_t) g.w * dx;
+        std::vector<float> plane(plane_size);
+        pool::PooledMat out_row(1, src.cols * CN, CV_8UC1);
+        uchar *orow = (*out_row).ptr<uchar>(0);
+
+        for (int r = row_begin; r < row_end; r++)
+        {
+            float fy = (float) r / ss;
+            int y = (int) fy;
+            float wy = fy - y;
+
+            // the grid rows above and below the image row, padding skipped
+            const float *g0 = g.at(y + 1, 0, 0);
+            const float *g1 = g.at(y + 2, 0, 0);
+            for (size_t i = 0; i < plane_size; i++)
+            {
+                plane[i] = g0[i] + wy * (g1[i] - g0[i]);
+            }
+
+            const uchar *srow = src.ptr<uchar>(r);
+            for (int c = 0; c < src.cols; c++)
+            {
+                const uchar *px = srow + c * CN;
+                float fz = (float) luma<CN>(px) / sr;
+                int z = (int) fz;
+                float wz = fz - z;
+                float wx = col_frac[c];
+
+                // the cell left of and below in luma the pixel, padding skipped
+                const float *base = &plane[(col_cell[c] + 1) * dx + (z + 1) * cell];
+                float acc[CN + 1];
+                for (int k = 0; k < cell; k++)
+                {
+                    float c0 = base[k] + wz * (base[cell + k] - base[k]);
+                    float c1 = base[dx + k] + wz * (base[dx + cell + k] - base[dx + k]);
+                    acc[k] = c0 + wx * (c1 - c0);
+                }
+
+                if (acc[CN] <= 0)
+                {
+                    std::copy(px, px + CN, orow + c * CN);
+                    continue;
+                }
+
+                float inv = 1.0f / acc[CN];
+                for (int k = 0; k < CN; k++)
+                {
+                    orow[c * CN + k] = (uchar) std::min(255.0f, acc[k] * inv + 0.5f);
+                }
+            }
+
+            // written last so dst may be src
+            std::copy(orow, orow + src.cols * CN, dst.ptr<uchar>(r));
+        }
+    }
+
+    template <int CN>
+    static void bilateralGridCn(cv::Mat &src, cv::Mat &dst, int ss, int sr)
+    {
+        Grid<CN> g(src.rows, src.cols, ss, sr);
+
+        // splat by bands of inner grid rows
+        exec::forEachBand(g.h - 2, [&](int y_begin, int y_end) {
+            splatRows<CN>(src, g, ss, sr, y_begin + 1, y_end + 1);
+        });
+
+        for (int pass = 0; pass < GRID_BLUR_PASSES; pass++)
+        {
+            blurGrid<CN>(g);
+        }
+
+        // the grid column and interpolation weight of every image column
+        std::vector<int> col_cell(src.cols);
+        std::vector<float> col_frac(src.cols);
+        for (int c = 0; c < src.cols; c++)
+        {
+            float fx = (float) c / ss;
+            col_cell[c] = (int) fx;
+            col_frac[c] = fx - col_cell[c];
+        }
+
+        dst.create(src.rows, src.cols, src.type());
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            sliceRows<CN>(src, dst, g, ss, sr, col_cell, col_frac, row_begin, row_end);
+        });
+    }
+
+    int bilateralGrid(cv::Mat &src, cv::Mat &dst, int sigma_space, int sigma_range)
+    {
+        if (src.empty() || src.depth() != CV_8U || sigma_space < 2 || sigma_space > 256 ||
+            sigma_range < 1 || sigma_range > 128)
+        {
+            return ERROR_CODE;
+        }
+
+        switch (src.channels())
+        {
+            case 1:
+                bilateralGridCn<1>(src, dst, sigma_space, sigma_range);
+                return SUCCESS_CODE;
+            case 3:
+                bilateralGridCn<3>(src, dst, sigma_space, sigma_range);
+                return SUCCESS_CODE;
+            case 4:
+                bilateralGridCn<4>(src, dst, sigma_space, sigma_range);
+                return SUCCESS_CODE;
+        }
+
+        return ERROR_CODE;
+    }
+}
@@ -0,0 +1,36 @@
+/**
+ * Header for the bilateral grid, an edge-preserving smoothing whose cost does not
+ * grow with its radius. Every pixel is splatted into a coarse 3D grid indexed by its
+ * position, downsampled by the spatial sigma, and by its luma, downsampled by the
+ * range sigma. The grid is blurred along all three axes, and each pixel then reads
+ * its smoothed color back by trilinear interpolation at its own position and luma.
+ * Pixels across an edge land in distant luma cells, so they are never averaged
+ * together. Splatting and slicing touch each pixel once and the grid is 1 / (sigma
+ * space^2 * sigma range) the size of the image volume, so a wider spatial sigma
+ * makes the grid smaller rather than the filter slower.
+ */
+
+#ifndef P1_BILATERAL
+#define P1_BILATERAL
+
+#include <opencv2/opencv.hpp>
+
+namespace bilateral
+{
+    /**
+     * Smooths an image with a bilateral grid, split into bands on the exec thread
+     * pool. The luma of a BGR or BGRA image, or the value of a gray image, decides
+     * which pixels are averaged together.
+     *
+     * @param src reference to the uchar source image with 1, 3 or 4 channels
+     * @param dst reference to the destination image, allocated at the size and type
+     *            of src. May be src.
+     * @param sigma_space the width of a grid cell in pixels, 2 - 256
+     * @param sigma_range the height of a grid cell in luma levels, 1 - 128
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int bilateralGrid(cv::Mat &src, cv::Mat &dst, int sigma_space, int sigma_range);
+}
+
+#endif
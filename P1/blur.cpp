@@ -0,0 +1,435 @@
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "blur.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// the fractional bits kept by the values between box passes. The sum of a box of
+// MAX_BOX_RADIUS still fits an int32.
+#define BOX_FRAC_BITS 8
+
+#define MAX_BOX_RADIUS 4096
+#define MAX_BOX_PASSES 6
+#define MIN_SIGMA 0.5
+#define MAX_SIGMA 256.0
+
+// past this sigma the poles of the recursive filter sit so close to 1 that its step
+// response rings by several values, so wider blurs go to the stacked box blurs
+#define MAX_RECURSIVE_SIGMA 64.0
+
+namespace blur
+{
+    void boxRadii(double sigma, int passes, int *radii)
+    {
+        // the widest odd box narrower than the ideal, and the next odd box up. The
+        // first m passes take the narrow box and the rest the wide one.
+        double var = 12.0 * sigma * sigma;
+        int wl = (int) floor(sqrt(var / passes + 1));
+        if (wl % 2 == 0)
+        {
+            wl--;
+        }
+        wl = std::max(1, wl);
+        int m = (int) lround((var - passes * wl * wl - 4.0 * passes * wl - 3.0 * passes) / (-4.0 * wl - 4));
+        m = std::max(0, std::min(passes, m));
+
+        for (int i = 0; i < passes; i++)
+        {
+            radii[i] = std::min(MAX_BOX_RADIUS, i < m ? (wl - 1) / 2 : (wl + 1) / 2);
+        }
+    }
+
+    // a running-sum box along one row of cols pixels of CN interleaved values. Pixels
+    // past either end repeat the edge pixel. The channels slide together, so their
+    // sums are independent chains the core can run side by side. The sums are exact,
+    // so only the scale back to a value rounds.
+    template <int CN>
+    static void boxRow(const int32_t *in, int32_t *out, int cols, int radius)
+    {
+        const float scale = 1.0f / (2 * radius + 1);
+        const int last = cols - 1;
+        int32_t sum[CN];
+        for (int k = 0; k < CN; k++)
+        {
+            sum[k] = (radius + 1) * in[k];
+            for (int i = 1; i <= radius; i++)
+            {
+                sum[k] += in[std::min(i, last) * CN + k];
+            }
+        }
+
+        // the window reaches past the left edge, then lies inside the row, then
+        // reaches past the right edge
+        int left_end = std::min(cols, radius + 1);
+        int right_begin = std::max(left_end, cols - radius - 1);
+        int c = 0;
+        for (; c < left_end; c++)
+        {
+            const int32_t *add = in + std::min(c + radius + 1, last) * CN;
+            for (int k = 0; k < CN; k++)
+            {
+                out[c * CN + k] = (int32_t) (sum[k] * scale + 0.5f);
+                sum[k] += add[k] - in[k];
+            }
+        }
+        for (; c < right_begin; c++)
+        {
+            const int32_t *add = in + (c + radius + 1) * CN;
+            const int32_t *sub = in + (c - radius) * CN;
+            for (int k = 0; k < CN; k++)
+            {
+                out[c * CN + k] = (int32_t) (sum[k] * scale + 0.5f);
+                sum[k] += add[k] - sub[k];
+            }
+        }
+        for (; c < cols; c++)
+        {
+            const int32_t *sub = in + std::max(c - radius, 0) * CN;
+            for (int k = 0; k < CN; k++)
+            {
+                out[c * CN + k] = (int32_t) (sum[k] * scale + 0.5f);
+                sum[k] += in[last * CN + k] - sub[k];
+            }
+        }
+    }
+
+    static void boxRow(const int32_t *in, int32_t *out, int cols, int cn, int radius)
+    {
+        switch (cn)
+        {
+            case 1:
+                boxRow<1>(in, out, cols, radius);
+                break;
+            case 3:
+                boxRow<3>(in, out, cols, radius);
+                break;
+            case 4:
+                boxRow<4>(in, out, cols, radius);
+                break;
+        }
+    }
+
+    // every box pass along the rows of [row_begin, row_end), from src into the
+    // fixed-point rows of h
+    static void boxRows(cv::Mat &src, cv::Mat &h, const int *radii, int passes, int row_begin, int row_end)
+    {
+        const int n = src.cols * src.channels();
+        std::vector<int32_t> a(n), b(n);
+        for (int r = row_begin; r < row_end; r++)
+        {
+            const uchar *srow = src.ptr<uchar>(r);
+            for (int i = 0; i < n; i++)
+            {
+                a[i] = srow[i] << BOX_FRAC_BITS;
+            }
+
+            for (int p = 0; p < passes; p++)
+            {
+                int32_t *out = p == passes - 1 ? h.ptr<int32_t>(r) : b.data();
+                boxRow(a.data(), out, src.cols, src.channels(), radii[p]);
+                std::swap(a, b);
+            }
+        }
+    }
+
+    // one box pass down the columns of rows [row_begin, row_end). The sums of every
+    // column start from the rows around row_begin and then slide down one row at a
+    // time, so each band reads only its own rows and the radius around them. The
+    // sums are exact whatever the bands, so any number of threads gives the same
+    // image.
+    template <typename T>
+    static void boxColumns(cv::Mat &in, T *out_base, size_t out_step, int n, int radius, bool last_pass, int row_begin, int row_end)
+    {
+        const int last = in.rows - 1;
+        const float scale = 1.0f / ((2 * radius + 1) * (last_pass ? 1 << BOX_FRAC_BITS : 1));
+
+        std::vector<int32_t> sums(n, 0);
+        for (int i = row_begin - radius; i <= row_begin + radius; i++)
+        {
+            const int32_t *row = in.ptr<int32_t>(std::max(0, std::min(i, last)));
+            for (int j = 0; j < n; j++)
+            {
+                sums[j] += row[j];
+            }
+        }
+
+        int32_t *s = sums.data();
+        for (int r = row_begin; r < row_end; r++)
+        {
+            T *orow = (T*) ((uchar*) out_base + r * out_step);
+            for (int j = 0; j < n; j++)
+            {
+                int32_t v = (int32_t) (s[j] * scale + 0.5f);
+                orow[j] = last_pass ? (T) std::min(255, v) : (T) v;
+            }
+
+            const int32_t *add = in.ptr<int32_t>(std::min(r + radius + 1, last));
+            const int32_t *sub = in.ptr<int32_t>(std::max(r - radius, 0));
+            for (int j = 0; j < n; j++)
+            {
+                s[j] += add[j] - sub[j];
+            }
+        }
+    }
+
+    // passes boxes of the given radii along the rows and then down the columns
+    static int boxPasses(cv::Mat &src, cv::Mat &dst, const int *radii, int passes)
+    {
+        if (src.empty() || src.depth() != CV_8U || (src.channels() != 1 && src.channels() != 3 && src.channels() != 4))
+        {
+            return ERROR_CODE;
+        }
+
+        const int n = src.cols * src.channels();
+        pool::PooledMat h(src.rows, n, CV_32SC1);
+        pool::PooledMat v(src.rows, n, CV_32SC1);
+        cv::Mat *in = h.get();
+        cv::Mat *out = v.get();
+
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            boxRows(src, *in, radii, passes, row_begin, row_end);
+        });
+
+        // the last pass reads only the fixed-point buffers, so dst may be src
+        dst.create(src.rows, src.cols, src.type());
+        for (int p = 0; p < passes; p++)
+        {
+            if (p == passes - 1)
+            {
+                exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+                    boxColumns<uchar>(*in, dst.ptr<uchar>(0), dst.step, n, radii[p], true, row_begin, row_end);
+                });
+                break;
+            }
+
+            exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+                boxColumns<int32_t>(*in, out->ptr<int32_t>(0), out->step, n, radii[p], false, row_begin, row_end);
+            });
+            std::swap(in, out);
+        }
+
+        return SUCCESS_CODE;
+    }
+
+    int boxBlur(cv::Mat &src, cv::Mat &dst, int radius)
+    {
+        if (radius < 0 || radius > MAX_BOX_RADIUS)
+        {
+            return ERROR_CODE;
+        }
+        return boxPasses(src, dst, &radius, 1);
+    }
+
+    int boxGaussian(cv::Mat &src, cv::Mat &dst, double sigma, int passes)
+    {
+        if (!(sigma >= MIN_SIGMA && sigma <= MAX_SIGMA) || passes < 1 || passes > MAX_BOX_PASSES)
+        {
+            return ERROR_CODE;
+        }
+
+        int radii[MAX_BOX_PASSES];
+        boxRadii(sigma, passes, radii);
+        return boxPasses(src, dst, radii, passes);
+    }
+
+    /**
+     * The coefficients of the Young and van Vliet recursive Gaussian. Each output is
+     * b times the input plus a1, a2 and a3 times the three outputs before it.
+     */
+    struct RecursiveCoeffs
+    {
+        double b, a1, a2, a3;
+
+        // maps the last three outputs of the forward pass, less the edge value, to
+        // the backward outputs at the last pixel and the two past it. Triggs and
+        // Sdika derive it so the backward pass starts as if the edge pixel repeated
+        // forever, where starting from the edge value alone smears the last few
+        // sigma of the image.
+        double m[3][3];
+
+        explicit RecursiveCoeffs(double sigma)
+        {
+            double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+            double q2 = q * q;
+            double q3 = q2 * q;
+            double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+            double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+            double b2 = -(1.4281 * q2 + 1.26661 * q3);
+            double b3 = 0.422205 * q3;
+
+            double c1 = b1 / b0;
+            double c2 = b2 / b0;
+            double c3 = b3 / b0;
+            double gain = 1 - (c1 + c2 + c3);
+            a1 = c1;
+            a2 = c2;
+            a3 = c3;
+            b = gain;
+
+            double scale = gain / ((1 + c1 - c2 + c3) * (1 - c1 - c2 - c3) * (1 + c2 + (c1 - c3) * c3));
+            double rows[3][3] = {
+                { -c3 * c1 + 1 - c3 * c3 - c2, (c3 + c1) * (c2 + c3 * c1), c3 * (c1 + c3 * c2) },
+                { c1 + c3 * c2, -(c2 - 1) * (c2 + c3 * c1), -(c3 * c1 + c3 * c3 + c2 - 1) * c3 },
+                { c3 * c1 + c2 + c1 * c1 - c2 * c2, c1 * c2 + c3 * c2 * c2 - c1 * c3 * c3 - c3 * c3 * c3 - c3 * c2 + c3, c3 * (c1 + c3 * c2) }
+            };
+            for (int i = 0; i < 3; i++)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    m[i][j] = rows[i][j] * scale;
+                }
+            }
+        }
+
+        /**
+         * Gets the backward outputs at the last value and the two past it.
+         *
+         * @param w1 the forward output at the last value
+         * @param w2 the forward output one before it
+         * @param w3 the forward output two before it
+         * @param edge the last input value
+         * @param y the three outputs
+         */
+        inline void backwardStart(double w1, double w2, double w3, double edge, double *y) const
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                y[i] = edge + m[i][0] * (w1 - edge) + m[i][1] * (w2 - edge) + m[i][2] * (w3 - edge);
+            }
+        }
+    };
+
+    // the forward and backward recursion along one row of cols pixels of cn
+    // interleaved values, from in into out, as if the edge pixels repeated forever
+    static void recursiveRow(const uchar *in, double *out, double *w, int cols, int cn, const RecursiveCoeffs &k)
+    {
+        const int last = cols - 1;
+        for (int ch = 0; ch < cn; ch++)
+        {
+            double w1 = in[ch], w2 = w1, w3 = w1;
+            for (int c = 0; c < cols; c++)
+            {
+                double v = k.b * in[c * cn + ch] + k.a1 * w1 + k.a2 * w2 + k.a3 * w3;
+                w[c] = v;
+                w3 = w2;
+                w2 = w1;
+                w1 = v;
+            }
+
+            double y[3];
+            k.backwardStart(w1, w2, w3, in[last * cn + ch], y);
+            out[last * cn + ch] = y[0];
+            double y1 = y[0], y2 = y[1], y3 = y[2];
+            for (int c = last - 1; c >= 0; c--)
+            {
+                double v = k.b * w[c] + k.a1 * y1 + k.a2 * y2 + k.a3 * y3;
+                out[c * cn + ch] = v;
+                y3 = y2;
+                y2 = y1;
+                y1 = v;
+            }
+        }
+    }
+
+    // the forward and backward recursion down the values [j_begin, j_end) of every
+    // row of f, in place, with the result rounded into dst. The recursion runs across
+    // whole rows, so memory is read in order and the inner loop vectorizes.
+    static void recursiveColumns(cv::Mat &f, cv::Mat &dst, const RecursiveCoeffs &k, int j_begin, int j_end)
+    {
+        const int n = j_end - j_begin;
+        const int last = f.rows - 1;
+
+        // the first and last rows as they were before the forward pass
+        std::vector<double> first(f.ptr<double>(0) + j_begin, f.ptr<double>(0) + j_end);
+        std::vector<double> edge(f.ptr<double>(last) + j_begin, f.ptr<double>(last) + j_end);
+        const double *e = first.data();
+        for (int r = 0; r < f.rows; r++)
+        {
+            double *row = f.ptr<double>(r) + j_begin;
+            const double *p1 = r >= 1 ? f.ptr<double>(r - 1) + j_begin : e;
+            const double *p2 = r >= 2 ? f.ptr<double>(r - 2) + j_begin : e;
+            const double *p3 = r >= 3 ? f.ptr<double>(r - 3) + j_begin : e;
+            for (int j = 0; j < n; j++)
+            {
+                row[j] = k.b * row[j] + k.a1 * p1[j] + k.a2 * p2[j] + k.a3 * p3[j];
+            }
+        }
+
+        // the backward outputs at the last row and the two rows past it
+        std::vector<double> past(2 * n);
+        {
+            const double *w1 = f.ptr<double>(last) + j_begin;
+            const double *w2 = last >= 1 ? f.ptr<double>(last - 1) + j_begin : e;
+            const double *w3 = last >= 2 ? f.ptr<double>(last - 2) + j_begin : e;
+            double *out = f.ptr<double>(last) + j_begin;
+            for (int j = 0; j < n; j++)
+            {
+                double y[3];
+                k.backwardStart(w1[j], w2[j], w3[j], edge[j], y);
+                out[j] = y[0];
+                past[j] = y[1];
+                past[n + j] = y[2];
+            }
+        }
+
+        for (int r = last; r >= 0; r--)
+        {
+            double *row = f.ptr<double>(r) + j_begin;
+            if (r < last)
+            {
+                const double *n1 = f.ptr<double>(r + 1) + j_begin;
+                const double *n2 = r + 2 <= last ? f.ptr<double>(r + 2) + j_begin : past.data();
+                const double *n3 = r + 3 <= last ? f.ptr<double>(r + 3) + j_begin : past.data() + (r + 3 - last - 1) * n;
+                for (int j = 0; j < n; j++)
+                {
+                    row[j] = k.b * row[j] + k.a1 * n1[j] + k.a2 * n2[j] + k.a3 * n3[j];
+                }
+            }
+
+            uchar *drow = dst.ptr<uchar>(r) + j_begin;
+            for (int j = 0; j < n; j++)
+            {
+                drow[j] = (uchar) std::max(0.0, std::min(255.0, row[j] + 0.5));
+            }
+        }
+    }
+
+    int recursiveGaussian(cv::Mat &src, cv::Mat &dst, double sigma)
+    {
+        if (src.empty() || src.depth() != CV_8U || (src.channels() != 1 && src.channels() != 3 && src.channels() != 4) ||
+            !(sigma >= MIN_SIGMA && sigma <= MAX_SIGMA))
+        {
+            return ERROR_CODE;
+        }
+        if (sigma > MAX_RECURSIVE_SIGMA)
+        {
+            return boxGaussian(src, dst, sigma);
+        }
+
+        const RecursiveCoeffs k(sigma);
+        const int n = src.cols * src.channels();
+        pool::PooledMat f(src.rows, n, CV_64FC1);
+
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            std::vector<double> w(src.cols);
+            for (int r = row_begin; r < row_end; r++)
+            {
+                recursiveRow(src.ptr<uchar>(r), (*f).ptr<double>(r), w.data(), src.cols, src.channels(), k);
+            }
+        });
+
+        // the column pass reads only the double buffer, so dst may be src
+        dst.create(src.rows, src.cols, src.type());
+        exec::forEachBand(n, [&](int j_begin, int j_end) {
+            recursiveColumns(*f, dst, k, j_begin, j_end);
+        });
+
+        return SUCCESS_CODE;
+    }
+}
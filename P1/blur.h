@@ -0,0 +1,74 @@
+/**
+ * Header for the blurs of any radius. blur5x5() is fixed at radius 2, and chaining it
+ * to blur further costs a full pass per call. These blurs instead cost the same per
+ * pixel whatever their radius: a box blur keeps a running sum along each row and
+ * down each column, adding the value entering the window and subtracting the value
+ * leaving it, and a Gaussian is either a few stacked box blurs, whose repeated
+ * convolution converges on a Gaussian, or a recursive filter which runs forwards and
+ * backwards along each row and column. Pixels outside the image take the value of the
+ * nearest edge pixel.
+ */
+
+#ifndef P1_BLUR
+#define P1_BLUR
+
+#include <opencv2/opencv.hpp>
+
+namespace blur
+{
+    /**
+     * Gets the radii of stacked box blurs approximating a Gaussian, so that the
+     * variances of the boxes add up as closely as whole radii allow to sigma^2.
+     *
+     * @param sigma the standard deviation of the Gaussian, in pixels
+     * @param passes the number of boxes
+     * @param radii array of passes radii to fill, smallest first
+     */
+    void boxRadii(double sigma, int passes, int *radii);
+
+    /**
+     * Blurs an image with a (2 * radius + 1) square box, split into row bands on the
+     * exec thread pool.
+     *
+     * @param src reference to the uchar source image
+     * @param dst reference to the destination image, allocated at the size and type
+     *            of src. May be src.
+     * @param radius the radius of the box, 0 - 4096
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int boxBlur(cv::Mat &src, cv::Mat &dst, int radius);
+
+    /**
+     * Blurs an image with stacked box blurs approximating a Gaussian. Three passes
+     * come within a value or two of a true Gaussian once sigma is a few pixels. Each
+     * pass repeats the edge of its own input, so pixels within the radius of the
+     * image edge weigh the edge pixels a little more than a true Gaussian would.
+     *
+     * @param src reference to the uchar source image
+     * @param dst reference to the destination image, allocated at the size and type
+     *            of src. May be src.
+     * @param sigma the standard deviation of the Gaussian, 0.5 - 256 pixels
+     * @param passes the number of box blurs, 1 - 6
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int boxGaussian(cv::Mat &src, cv::Mat &dst, double sigma, int passes = 3);
+
+    /**
+     * Blurs an image with the recursive Gaussian of Young and van Vliet: a third
+     * order filter run forwards then backwards along each row, then down and up each
+     * column, in double precision. Rows are split into bands and columns into strips
+     * on the exec thread pool. A sigma above 64 pixels is handed to boxGaussian().
+     *
+     * @param src reference to the uchar source image
+     * @param dst reference to the destination image, allocated at the size and type
+     *            of src. May be src.
+     * @param sigma the standard deviation of the Gaussian, 0.5 - 256 pixels
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int recursiveGaussian(cv::Mat &src, cv::Mat &dst, double sigma);
+}
+
+#endif
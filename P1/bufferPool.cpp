@@ -0,0 +1,74 @@
+#include <opencv2/opencv.hpp>
+#include "bufferPool.h"
+
+namespace pool
+{
+    cv::Mat BufferPool::acquire(int rows, int cols, int type)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            std::vector<cv::Mat> &bufs = idle[Key(rows, cols, type)];
+            if (!bufs.empty())
+            {
+                cv::Mat buf = bufs.back();
+                bufs.pop_back();
+                counters.hits++;
+                return buf;
+            }
+            counters.misses++;
+        }
+
+        return cv::Mat(rows, cols, type);
+    }
+
+    void BufferPool::release(cv::Mat &buf)
+    {
+        if (buf.empty())
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mtx);
+        idle[Key(buf.rows, buf.cols, buf.type())].push_back(buf);
+        buf.release();
+    }
+
+    PoolStats BufferPool::stats()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        PoolStats s = counters;
+        for (auto it = idle.begin(); it != idle.end(); it++)
+        {
+            for (size_t i = 0; i < it->second.size(); i++)
+            {
+                s.idle_buffers++;
+                s.idle_bytes += it->second[i].total() * it->second[i].elemSize();
+            }
+        }
+
+        return s;
+    }
+
+    void BufferPool::clear()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        idle.clear();
+        counters = PoolStats();
+    }
+
+    BufferPool& framePool()
+    {
+        static BufferPool frame_pool;
+        return frame_pool;
+    }
+
+    PooledMat::PooledMat(int rows, int cols, int type, BufferPool &p):
+        owner(&p),
+        buf(p.acquire(rows, cols, type))
+    {}
+
+    PooledMat::~PooledMat()
+    {
+        owner->release(buf);
+    }
+}
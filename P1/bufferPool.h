@@ -0,0 +1,138 @@
+/**
+ * Header for the frame-buffer pool. Filters and VidDisplay draw their destination
+ * images and intermediates from the pool instead of allocating a new cv::Mat for
+ * every frame, and return them when done. Buffers are keyed by size and type, so once
+ * each buffer a frame needs has been allocated the steady state allocates nothing.
+ */
+
+#ifndef P1_BUFFER_POOL
+#define P1_BUFFER_POOL
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace pool
+{
+    /**
+     * Counters describing how well the pool is serving requests.
+     */
+    struct PoolStats
+    {
+        // requests served by a returned buffer
+        long hits = 0;
+
+        // requests which had to allocate a new buffer
+        long misses = 0;
+
+        // buffers currently sitting in the pool
+        long idle_buffers = 0;
+
+        // bytes held by the idle buffers
+        size_t idle_bytes = 0;
+    };
+
+    /**
+     * A thread-safe pool of cv::Mat buffers keyed by rows, cols and type.
+     */
+    class BufferPool
+    {
+        private:
+            typedef std::tuple<int, int, int> Key;
+
+            // the idle buffers of each size and type
+            std::map<Key, std::vector<cv::Mat>> idle;
+
+            // the request counters
+            PoolStats counters;
+
+            // guards the pool state
+            std::mutex mtx;
+
+        public:
+            /**
+             * Takes a buffer of the given size and type out of the pool, allocating one
+             * if none is idle. The contents of the buffer are undefined.
+             *
+             * @param rows the number of rows
+             * @param cols the number of cols
+             * @param type the OpenCV type of the buffer
+             *
+             * @return the buffer
+             */
+            cv::Mat acquire(int rows, int cols, int type);
+
+            /**
+             * Returns a buffer to the pool. The caller must not use the buffer afterwards.
+             *
+             * @param buf the buffer to return
+             */
+            void release(cv::Mat &buf);
+
+            /**
+             * Getter for the pool counters.
+             *
+             * @return a snapshot of the counters
+             */
+            PoolStats stats();
+
+            /**
+             * Frees every idle buffer and resets the counters.
+             */
+            void clear();
+    };
+
+    /**
+     * Getter for the pool shared by the filters and VidDisplay.
+     *
+     * @return the shared frame-buffer pool
+     */
+    BufferPool& framePool();
+
+    /**
+     * A buffer borrowed from a pool for the lifetime of this object.
+     */
+    class PooledMat
+    {
+        private:
+            // the pool the buffer goes back to
+            BufferPool *owner;
+
+            // the borrowed buffer
+            cv::Mat buf;
+
+        public:
+            /**
+             * Primary constructor for the PooledMat. Borrows a buffer of the given size
+             * and type.
+             *
+             * @param rows the number of rows
+             * @param cols the number of cols
+             * @param type the OpenCV type of the buffer
+             * @param p the pool to borrow from
+             */
+            PooledMat(int rows, int cols, int type, BufferPool &p = framePool());
+            ~PooledMat();
+
+            PooledMat(const PooledMat&) = delete;
+            PooledMat& operator=(const PooledMat&) = delete;
+
+            /**
+             * Getter for the borrowed buffer.
+             *
+             * @return a pointer to the buffer
+             */
+            cv::Mat* get() { return &buf; }
+
+            /**
+             * Getter for the borrowed buffer.
+             *
+             * @return a reference to the buffer
+             */
+            cv::Mat& operator*() { return buf; }
+    };
+}
+
+#endif
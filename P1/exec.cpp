@@ -0,0 +1,149 @@
+#include <algorithm>
+#include "exec.h"
+
+// bands shorter than this cost more to schedule than they save
+#define MIN_BAND_ROWS 16
+
+namespace exec
+{
+    // set while the current thread is running a task, so nested jobs run inline
+    static thread_local bool in_task = false;
+
+    ThreadPool::ThreadPool(int n_threads)
+    {
+        for (int t = 1; t < n_threads; t++)
+        {
+            workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        work_cv.notify_all();
+
+        for (size_t t = 0; t < workers.size(); t++)
+        {
+            workers[t].join();
+        }
+    }
+
+    int ThreadPool::size()
+    {
+        return (int) workers.size() + 1;
+    }
+
+    void ThreadPool::drain(std::unique_lock<std::mutex> &lock)
+    {
+        while (next_task < n_tasks)
+        {
+            int task = next_task++;
+            const std::function<void(int)> *fn = job;
+
+            lock.unlock();
+            in_task = true;
+            (*fn)(task);
+            in_task = false;
+            lock.lock();
+
+            if (--pending == 0)
+            {
+                done_cv.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        long seen = 0;
+        std::unique_lock<std::mutex> lock(mtx);
+        for (;;)
+        {
+            work_cv.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+
+            seen = generation;
+            drain(lock);
+        }
+    }
+
+    void ThreadPool::parallelFor(int n, const std::function<void(int)> &fn)
+    {
+        if (in_task || workers.empty() || n <= 1)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                fn(i);
+            }
+            return;
+        }
+
+        std::unique_lock<std::mutex> submit(submit_mtx);
+        std::unique_lock<std::mutex> lock(mtx);
+        job = &fn;
+        n_tasks = n;
+        next_task = 0;
+        pending = n;
+        generation++;
+        work_cv.notify_all();
+
+        drain(lock);
+        done_cv.wait(lock, [&] { return pending == 0; });
+        job = nullptr;
+    }
+
+    static std::mutex pool_mtx;
+    static ThreadPool *pool = nullptr;
+    static int n_threads = 1;
+
+    void setThreads(int n)
+    {
+        if (n <= 0)
+        {
+            n = std::max(1, (int) std::thread::hardware_concurrency());
+        }
+
+        std::unique_lock<std::mutex> lock(pool_mtx);
+        if (pool != nullptr && pool->size() != n)
+        {
+            delete pool;
+            pool = nullptr;
+        }
+        n_threads = n;
+    }
+
+    int threads()
+    {
+        return n_threads;
+    }
+
+    void forEachBand(int rows, const std::function<void(int, int)> &fn)
+    {
+        int n_bands = std::min(n_threads, rows / MIN_BAND_ROWS);
+        if (n_bands <= 1 || in_task)
+        {
+            fn(0, rows);
+            return;
+        }
+
+        ThreadPool *p;
+        {
+            std::unique_lock<std::mutex> lock(pool_mtx);
+            if (pool == nullptr)
+            {
+                pool = new ThreadPool(n_threads);
+            }
+            p = pool;
+        }
+
+        p->parallelFor(n_bands, [&](int b) {
+            fn(rows * b / n_bands, rows * (b + 1) / n_bands);
+        });
+    }
+}
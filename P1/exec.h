@@ -0,0 +1,125 @@
+/**
+ * Header for the multi-threaded execution of the filters. A filter is split into
+ * horizontal bands of output rows which run on a persistent thread pool. Each band
+ * reads the halo rows its kernel needs from the shared source image, so the output
+ * is byte-identical to running the filter over the whole frame on one thread.
+ */
+
+#ifndef P1_EXEC
+#define P1_EXEC
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace exec
+{
+    /**
+     * A fixed set of worker threads which stay alive between jobs. The thread that
+     * submits a job works on it alongside the workers and returns once every task
+     * of the job has finished.
+     */
+    class ThreadPool
+    {
+        private:
+            // the worker threads, one fewer than the size of the pool
+            std::vector<std::thread> workers;
+
+            // guards the job state below
+            std::mutex mtx;
+
+            // signalled when a new job is posted or the pool is stopping
+            std::condition_variable work_cv;
+
+            // signalled when the last task of a job finishes
+            std::condition_variable done_cv;
+
+            // serializes jobs submitted from different threads
+            std::mutex submit_mtx;
+
+            // the task function of the current job
+            const std::function<void(int)> *job = nullptr;
+
+            // the number of tasks in the current job
+            int n_tasks = 0;
+
+            // the next task of the current job to hand out
+            int next_task = 0;
+
+            // the number of tasks of the current job not yet finished
+            int pending = 0;
+
+            // incremented for every job so workers can tell a new job from a spurious wakeup
+            long generation = 0;
+
+            // is the pool shutting down
+            bool stopping = false;
+
+            /**
+             * Runs tasks of the current job until none are left to hand out.
+             *
+             * @param lock the held lock on mtx, released while a task runs
+             */
+            void drain(std::unique_lock<std::mutex> &lock);
+
+            /**
+             * Main loop of a worker thread.
+             */
+            void workerLoop();
+
+        public:
+            /**
+             * Primary constructor for the ThreadPool.
+             *
+             * @param n_threads the total number of threads working on a job, including
+             *                  the submitting thread
+             */
+            ThreadPool(int n_threads);
+            ~ThreadPool();
+
+            /**
+             * Getter for the number of threads working on a job.
+             *
+             * @return the size of the pool
+             */
+            int size();
+
+            /**
+             * Runs fn(0) ... fn(n - 1) across the pool and waits for all of them.
+             * Calls made from inside a task run inline on the calling thread.
+             *
+             * @param n the number of tasks
+             * @param fn the task function
+             */
+            void parallelFor(int n, const std::function<void(int)> &fn);
+    };
+
+    /**
+     * Sets the number of threads the filters run on. 1 runs every filter on the
+     * calling thread, which is the default. Must not be called while a filter is
+     * running.
+     *
+     * @param n_threads the number of threads, or 0 for one per hardware thread
+     */
+    void setThreads(int n_threads);
+
+    /**
+     * Getter for the number of threads the filters run on.
+     *
+     * @return the number of threads
+     */
+    int threads();
+
+    /**
+     * Splits the rows [0, rows) into bands, one per thread, and runs fn(row_begin,
+     * row_end) for each band on the thread pool. Waits for every band to finish.
+     *
+     * @param rows the number of output rows
+     * @param fn the band function
+     */
+    void forEachBand(int rows, const std::function<void(int, int)> &fn);
+}
+
+#endif
@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "filters.h"
+#include "filterGraph.h"
+#include "blur.h"
+#include "yuv.h"
+#include "pointExpr.h"
+#include "simd.h"
+#include "exec.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// timed runs of each case, after the warm-up runs
+#define DEFAULT_ITERATIONS 50
+
+// untimed runs which fill the buffer pool and the caches
+#define WARMUP_ITERATIONS 3
+
+#define BENCH_LEVELS 15
+#define BENCH_MAG_THRESHOLD 15
+#define BENCH_ORIENTATION_BINS 8
+
+// the grid cell of the bilateral cartoon, and the sigmas of bilateralFilter
+#define BENCH_SIGMA_SPACE 16
+#define BENCH_SIGMA_RANGE 16
+
+// the blurs of any radius, and the blur5x5() calls reaching the same sigma: each
+// call adds a variance of 1.2, so 53 of them add up to 8^2
+#define BENCH_BOX_RADIUS 8
+#define BENCH_BLUR_SIGMA 8.0
+#define BENCH_BLUR5X5_CHAIN 53
+
+typedef std::chrono::steady_clock Clock;
+
+// A resolution to benchmark at
+struct Resolution
+{
+    const char *name;
+    int cols;
+    int rows;
+};
+
+// The inputs every case reads from, prepared once per resolution
+struct BenchInputs
+{
+    // a random CV_8UC3 frame
+    cv::Mat frame;
+
+    // the SobelX and SobelY responses of the frame, as sobelX3x3() and sobelY3x3()
+    // produce them
+    cv::Mat sx;
+    cv::Mat sy;
+
+    // the same responses as floats, for cv::magnitude
+    cv::Mat sx_f;
+    cv::Mat sy_f;
+
+    // the frame as I420, the way a camera delivers it
+    cv::Mat i420;
+};
+
+// A function from filters.h paired with the OpenCV call, or the chain of filters.h
+// calls, doing the same work
+struct BenchCase
+{
+    // the name of the function
+    const char *name;
+
+    // the name of the OpenCV equivalent
+    const char *reference_name;
+
+    // runs the function once
+    std::function<void(BenchInputs &, cv::Mat &)> run;
+
+    // runs the OpenCV equivalent once
+    std::function<void(BenchInputs &, cv::Mat &)> reference;
+};
+
+// Median and 99th percentile of a set of timings
+struct Timing
+{
+    double median_ms = 0;
+    double p99_ms = 0;
+};
+
+Timing time_runs(const std::function<void(BenchInputs &, cv::Mat &)> &fn, BenchInputs &in, int iterations)
+{
+    cv::Mat dst;
+    for (int i = 0; i < WARMUP_ITERATIONS; i++)
+    {
+        fn(in, dst);
+    }
+
+    std::vector<double> ms(iterations);
+    for (int i = 0; i < iterations; i++)
+    {
+        Clock::time_point start = Clock::now();
+        fn(in, dst);
+        ms[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // nearest-rank percentiles
+    std::sort(ms.begin(), ms.end());
+    Timing t;
+    t.median_ms = ms[(iterations - 1) / 2];
+    t.p99_ms = ms[std::min(iterations - 1, (int) ((iterations * 99 + 99) / 100) - 1)];
+    return t;
+}
+
+cv::Mat quantize_table(int levels)
+{
+    cv::Mat table(1, 256, CV_8UC1);
+    int b = 255/levels;
+    for (int v = 0; v < 256; v++)
+    {
+        table.ptr<uchar>(0)[v] = (v / b) * b;
+    }
+    return table;
+}
+
+// blur5x5() called n times over, as the only way to blur wider before blur.h
+void chain_blur5x5(cv::Mat &src, cv::Mat &dst, int n)
+{
+    cv::Mat tmp;
+    blur5x5(src, dst);
+    for (int i = 1; i < n; i++)
+    {
+        blur5x5(dst, tmp);
+        std::swap(dst, tmp);
+    }
+}
+
+std::vector<BenchCase> bench_cases()
+{
+    static const cv::Mat quantize_lut = quantize_table(BENCH_LEVELS);
+    static const cv::Mat negative_lut = [] {
+        cv::Mat table(1, 256, CV_8UC1);
+        for (int v = 0; v < 256; v++)
+        {
+            table.ptr<uchar>(0)[v] = 255 - v;
+        }
+        return table;
+    }();
+
+    std::vector<BenchCase> cases;
+    cases.push_back({
+        "convertToUchar", "convertScaleAbs",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.sx.rows, in.sx.cols, CV_8UC3);
+            convertToUchar(&in.sx, &dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::convertScaleAbs(in.sx, dst); }});
+    cases.push_back({
+        "grayscale", "cvtColor",
+        [](BenchInputs &in, cv::Mat &dst) { grayscale(&in.frame, &dst); },
+        [](BenchInputs &in, cv::Mat &dst) { cv::cvtColor(in.frame, dst, cv::COLOR_BGR2GRAY); }});
+    cases.push_back({
+        "blur5x5", "GaussianBlur",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            blur5x5(in.frame, dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::GaussianBlur(in.frame, dst, cv::Size(5, 5), 0); }});
+    cases.push_back({
+        "applySobel", "Sobel",
+        [](BenchInputs &in, cv::Mat &dst) {
+            int h[] = {-1, 0, 1};
+            int v[] = {1, 2, 1};
+            dst.create(in.frame.rows, in.frame.cols, CV_16SC3);
+            applySobel(in.frame, dst, h, v, 3);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::Sobel(in.frame, dst, CV_16S, 1, 0, 3); }});
+    cases.push_back({
+        "sobelX3x3", "Sobel",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_16SC3);
+            sobelX3x3(in.frame, dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::Sobel(in.frame, dst, CV_16S, 1, 0, 3); }});
+    cases.push_back({
+        "sobelY3x3", "Sobel",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_16SC3);
+            sobelY3x3(in.frame, dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::Sobel(in.frame, dst, CV_16S, 0, 1, 3); }});
+    cases.push_back({
+        "sobel", "Sobel",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_16SC3);
+            sobel(&in.frame, &dst, 'x');
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::Sobel(in.frame, dst, CV_16S, 1, 0, 3); }});
+    cases.push_back({
+        "magnitude", "magnitude",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            magnitude(in.sx, in.sy, dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::magnitude(in.sx_f, in.sy_f, dst); }});
+    cases.push_back({
+        "magnitudeFilter", "Sobel+magnitude",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            magnitudeFilter(&in.frame, &dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat fx, fy;
+            cv::Sobel(in.frame, fx, CV_32F, 1, 0, 3);
+            cv::Sobel(in.frame, fy, CV_32F, 0, 1, 3);
+            cv::magnitude(fx.reshape(1), fy.reshape(1), dst);
+        }});
+    cases.push_back({
+        "blurQuantize", "GaussianBlur+LUT",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            blurQuantize(in.frame, dst, BENCH_LEVELS);
+        },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat blurred;
+            cv::GaussianBlur(in.frame, blurred, cv::Size(5, 5), 0);
+            cv::LUT(blurred, quantize_lut, dst);
+        }});
+    cases.push_back({
+        "negative", "LUT",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            negative(in.frame, dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) { cv::LUT(in.frame, negative_lut, dst); }});
+    cases.push_back({
+        "cartoon", "GaussianBlur+LUT+Sobel+magnitude",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            cartoon(in.frame, dst, BENCH_LEVELS, BENCH_MAG_THRESHOLD);
+        },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat blurred, fx, fy, mag, mask;
+            cv::GaussianBlur(in.frame, blurred, cv::Size(5, 5), 0);
+            cv::LUT(blurred, quantize_lut, dst);
+            cv::Sobel(in.frame, fx, CV_32F, 1, 0, 3);
+            cv::Sobel(in.frame, fy, CV_32F, 0, 1, 3);
+            cv::magnitude(fx.reshape(1), fy.reshape(1), mag);
+            cv::compare(mag.reshape(3), BENCH_MAG_THRESHOLD, mask, cv::CMP_GT);
+            dst.setTo(0, mask);
+        }});
+    cases.push_back({
+        "cartoonBilateral", "bilateralFilter+LUT+Sobel+magnitude",
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            cartoonBilateral(
+                in.frame, dst, BENCH_LEVELS, BENCH_MAG_THRESHOLD, BENCH_SIGMA_SPACE, BENCH_SIGMA_RANGE);
+        },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat smooth, fx, fy, mag, mask;
+            cv::bilateralFilter(in.frame, smooth, -1, BENCH_SIGMA_RANGE, BENCH_SIGMA_SPACE);
+            cv::LUT(smooth, quantize_lut, dst);
+            cv::Sobel(in.frame, fx, CV_32F, 1, 0, 3);
+            cv::Sobel(in.frame, fy, CV_32F, 0, 1, 3);
+            cv::magnitude(fx.reshape(1), fy.reshape(1), mag);
+            cv::compare(mag.reshape(3), BENCH_MAG_THRESHOLD, mask, cv::CMP_GT);
+            dst.setTo(0, mask);
+        }});
+    cases.push_back({
+        "orientation", "Sobel+phase",
+        [](BenchInputs &in, cv::Mat &dst) { orientation(&in.frame, &dst, BENCH_ORIENTATION_BINS); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat fx, fy;
+            cv::Sobel(in.frame, fx, CV_32F, 1, 0, 3);
+            cv::Sobel(in.frame, fy, CV_32F, 0, 1, 3);
+            cv::phase(fx.reshape(1), fy.reshape(1), dst, true);
+        }});
+
+    // blurs whose cost does not grow with their radius
+    cases.push_back({
+        "boxBlur", "blur",
+        [](BenchInputs &in, cv::Mat &dst) { blur::boxBlur(in.frame, dst, BENCH_BOX_RADIUS); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::blur(in.frame, dst, cv::Size(2 * BENCH_BOX_RADIUS + 1, 2 * BENCH_BOX_RADIUS + 1), cv::Point(-1, -1), cv::BORDER_REPLICATE);
+        }});
+    cases.push_back({
+        "boxGaussian", "blur5x5 x53",
+        [](BenchInputs &in, cv::Mat &dst) { blur::boxGaussian(in.frame, dst, BENCH_BLUR_SIGMA); },
+        [](BenchInputs &in, cv::Mat &dst) { chain_blur5x5(in.frame, dst, BENCH_BLUR5X5_CHAIN); }});
+    cases.push_back({
+        "recursiveGaussian", "blur5x5 x53",
+        [](BenchInputs &in, cv::Mat &dst) { blur::recursiveGaussian(in.frame, dst, BENCH_BLUR_SIGMA); },
+        [](BenchInputs &in, cv::Mat &dst) { chain_blur5x5(in.frame, dst, BENCH_BLUR5X5_CHAIN); }});
+
+    // edges found once on luma, against on each color channel
+    cases.push_back({
+        "magnitudeLuma", "magnitudeFilter",
+        [](BenchInputs &in, cv::Mat &dst) { magnitudeLuma(in.frame, dst); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            magnitudeFilter(&in.frame, &dst);
+        }});
+    cases.push_back({
+        "cartoonLuma", "cartoon",
+        [](BenchInputs &in, cv::Mat &dst) { cartoonLuma(in.frame, dst, BENCH_LEVELS, BENCH_MAG_THRESHOLD); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            dst.create(in.frame.rows, in.frame.cols, CV_8UC3);
+            cartoon(in.frame, dst, BENCH_LEVELS, BENCH_MAG_THRESHOLD);
+        }});
+
+    // chains of point operations fused into one pass, against a pass per operation
+    cases.push_back({
+        "expr::quantize", "negative+LUT",
+        [](BenchInputs &in, cv::Mat &dst) { expr::eval(expr::quantize(expr::negative(in.frame), BENCH_LEVELS), dst); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat inverted(in.frame.rows, in.frame.cols, CV_8UC3);
+            negative(in.frame, inverted);
+            cv::LUT(inverted, quantize_lut, dst);
+        }});
+    cases.push_back({
+        "expr::threshold", "magnitude+compare",
+        [](BenchInputs &in, cv::Mat &dst) {
+            expr::eval(expr::threshold(expr::magnitude(in.sx, in.sy), BENCH_MAG_THRESHOLD), dst);
+        },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat mag;
+            magnitude(in.sx, in.sy, mag);
+            cv::compare(mag, BENCH_MAG_THRESHOLD, dst, cv::CMP_GT);
+        }});
+
+    // luma filters on a YUV frame, against converting it to BGR first as a camera
+    // frame is today
+    cases.push_back({
+        "yuv::grayscale", "YUV2BGR+grayscale",
+        [](BenchInputs &in, cv::Mat &dst) { yuv::grayscale(in.i420, yuv::FORMAT_I420, dst); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat bgr;
+            cv::cvtColor(in.i420, bgr, cv::COLOR_YUV2BGR_I420);
+            grayscale(&bgr, &dst);
+        }});
+    cases.push_back({
+        "yuv::magnitudeFilter", "YUV2BGR+magnitudeFilter",
+        [](BenchInputs &in, cv::Mat &dst) { yuv::magnitudeFilter(in.i420, yuv::FORMAT_I420, dst); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat bgr;
+            cv::cvtColor(in.i420, bgr, cv::COLOR_YUV2BGR_I420);
+            dst.create(bgr.rows, bgr.cols, bgr.type());
+            magnitudeFilter(&bgr, &dst);
+        }});
+
+    // a chain run through the filter graph, planned once and fused tile by tile
+    static graph::FilterGraph edge_chain;
+    edge_chain.clear();
+    edge_chain.grayscale().blur5x5().sobelX3x3().convertToUchar();
+    cases.push_back({
+        "FilterGraph", "cvtColor+GaussianBlur+Sobel+convertScaleAbs",
+        [](BenchInputs &in, cv::Mat &dst) { edge_chain.run(in.frame, dst); },
+        [](BenchInputs &in, cv::Mat &dst) {
+            cv::Mat gray, blurred, fx;
+            cv::cvtColor(in.frame, gray, cv::COLOR_BGR2GRAY);
+            cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 0);
+            cv::Sobel(blurred, fx, CV_16S, 1, 0, 3);
+            cv::convertScaleAbs(fx, dst);
+        }});
+
+    return cases;
+}
+
+void prepare_inputs(const Resolution &res, BenchInputs *in)
+{
+    in->frame.create(res.rows, res.cols, CV_8UC3);
+    cv::randu(in->frame, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    in->sx.create(res.rows, res.cols, CV_16SC3);
+    in->sy.create(res.rows, res.cols, CV_16SC3);
+    sobelX3x3(in->frame, in->sx);
+    sobelY3x3(in->frame, in->sy);
+
+    // cv::magnitude takes single channel floats
+    in->sx.reshape(1).convertTo(in->sx_f, CV_32F);
+    in->sy.reshape(1).convertTo(in->sy_f, CV_32F);
+
+    cv::cvtColor(in->frame, in->i420, cv::COLOR_BGR2YUV_I420);
+}
+
+// compares the luma gradient mode with the filters' per-channel gradients on one
+// image: how many of the per-channel edges luma finds, how many luma edges are
+// per-channel edges too, and how far apart the two cartoons are
+void print_luma_quality(cv::Mat &img, const char *name)
+{
+    int cn = img.channels();
+    cv::Mat mag(img.rows, img.cols, img.type());
+    cv::Mat luma_mag, color_cartoon(img.rows, img.cols, img.type()), luma_cartoon;
+    magnitudeFilter(&img, &mag);
+    magnitudeLuma(img, luma_mag);
+    cartoon(img, color_cartoon, BENCH_LEVELS, BENCH_MAG_THRESHOLD);
+    cartoonLuma(img, luma_cartoon, BENCH_LEVELS, BENCH_MAG_THRESHOLD);
+
+    // a pixel is an edge of the per-channel cartoon if any of its channels is masked
+    long both = 0;
+    long color_edges = 0;
+    long luma_edges = 0;
+    double squared_error = 0;
+    for (int r = 0; r < img.rows; r++)
+    {
+        const uchar *mrow = mag.ptr<uchar>(r);
+        const uchar *lrow = luma_mag.ptr<uchar>(r);
+        const uchar *crow = color_cartoon.ptr<uchar>(r);
+        const uchar *drow = luma_cartoon.ptr<uchar>(r);
+        for (int c = 0; c < img.cols; c++)
+        {
+            bool color_edge = false;
+            for (int k = 0; k < cn; k++)
+            {
+                color_edge = color_edge || mrow[c * cn + k] > BENCH_MAG_THRESHOLD;
+            }
+            bool luma_edge = lrow[c * cn] > BENCH_MAG_THRESHOLD;
+            color_edges += color_edge;
+            luma_edges += luma_edge;
+            both += color_edge && luma_edge;
+        }
+        for (int i = 0; i < img.cols * cn; i++)
+        {
+            double d = crow[i] - drow[i];
+            squared_error += d * d;
+        }
+    }
+
+    double mse = squared_error / ((double) img.total() * cn);
+    printf(
+        "\nLuma gradients on %s (%dx%d): %.1f%% of per-channel edges found, %.1f%% of luma edges are per-channel edges, ",
+        name, img.cols, img.rows,
+        color_edges > 0 ? 100.0 * both / color_edges : 100.0, luma_edges > 0 ? 100.0 * both / luma_edges : 100.0);
+    if (mse > 0)
+    {
+        printf("cartoon PSNR %.2f dB\n", 10 * log10(255.0 * 255.0 / mse));
+    }
+    else
+    {
+        printf("cartoons identical\n");
+    }
+}
+
+void print_usage()
+{
+    printf("usage: FilterBench [-t n_threads] [-n iterations] [-o csv_path] [-q quality_image]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int n_threads = 0;
+    int iterations = DEFAULT_ITERATIONS;
+    const char *csv_path = "filter_bench.csv";
+    const char *quality_path = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-t") == 0 && has_value && isdigit(argv[i + 1][0]))
+        {
+            n_threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && has_value && isdigit(argv[i + 1][0]))
+        {
+            iterations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && has_value)
+        {
+            csv_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-q") == 0 && has_value)
+        {
+            quality_path = argv[++i];
+        }
+        else
+        {
+            print_usage();
+            return ERROR_CODE;
+        }
+    }
+    if (iterations < 1)
+    {
+        print_usage();
+        return ERROR_CODE;
+    }
+
+    FILE *csv = fopen(csv_path, "w");
+    if (!csv)
+    {
+        printf("Failed to open %s\n", csv_path);
+        return ERROR_CODE;
+    }
+
+    // defaults to one filter thread per hardware thread
+    exec::setThreads(n_threads);
+    printf(
+        "Filter threads: %d, ISA: %s, OpenCV threads: %d, %d iterations\n",
+        exec::threads(), simd::isaName(simd::isa()), cv::getNumThreads(), iterations);
+
+    fprintf(
+        csv, "function,resolution,cols,rows,threads,isa,iterations,median_ms,p99_ms,"
+        "opencv_function,opencv_median_ms,opencv_p99_ms,speedup\n");
+
+    const Resolution resolutions[] = {
+        {"480p", 640, 480},
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160}};
+
+    std::vector<BenchCase> cases = bench_cases();
+    for (const Resolution &res : resolutions)
+    {
+        BenchInputs in;
+        prepare_inputs(res, &in);
+
+        printf("\n%s (%dx%d)\n", res.name, res.cols, res.rows);
+        printf(
+            "  %-16s %10s %10s   %-44s %10s %10s %8s\n",
+            "function", "median ms", "p99 ms", "opencv", "median ms", "p99 ms", "speedup");
+
+        for (const BenchCase &bench : cases)
+        {
+            Timing ours = time_runs(bench.run, in, iterations);
+            Timing ref = time_runs(bench.reference, in, iterations);
+            double speedup = ours.median_ms > 0 ? ref.median_ms / ours.median_ms : 0;
+
+            printf(
+                "  %-16s %10.3f %10.3f   %-44s %10.3f %10.3f %7.2fx\n",
+                bench.name, ours.median_ms, ours.p99_ms,
+                bench.reference_name, ref.median_ms, ref.p99_ms, speedup);
+            fprintf(
+                csv, "%s,%s,%d,%d,%d,%s,%d,%.4f,%.4f,%s,%.4f,%.4f,%.3f\n",
+                bench.name, res.name, res.cols, res.rows, exec::threads(), simd::isaName(simd::isa()),
+                iterations, ours.median_ms, ours.p99_ms,
+                bench.reference_name, ref.median_ms, ref.p99_ms, speedup);
+        }
+    }
+
+    fclose(csv);
+    printf("\nResults written to %s\n", csv_path);
+
+    // random pixels have edges everywhere, so the quality of the luma gradients is
+    // only meaningful on a real image
+    if (quality_path)
+    {
+        cv::Mat img = cv::imread(quality_path);
+        if (img.empty())
+        {
+            printf("Failed to read %s\n", quality_path);
+            return ERROR_CODE;
+        }
+        print_luma_quality(img, quality_path);
+    }
+
+    return SUCCESS_CODE;
+}
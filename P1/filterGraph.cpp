@@ -0,0 +1,573 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include "filterGraph.h"
+#include "filterTaps.h"
+#include "gradient.h"
+#include "simd.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// the intermediates of one tile are kept within this many bytes, about the size of a
+// core's L2 cache, so a stage reads back rows the stage before it has just written
+#define GRAPH_TILE_BYTES (256 * 1024)
+
+// tiles are never shorter than this, so the halo rows recomputed at the top and
+// bottom of each tile stay a small fraction of the work
+#define GRAPH_MIN_TILE_ROWS 16
+
+#define BLUR_HALO 2
+#define SOBEL_HALO 1
+
+// the parameters parseChain() uses when a spec leaves them out
+#define DEFAULT_ORIENTATION_BINS 8
+#define DEFAULT_LEVELS 15
+
+namespace graph
+{
+    FilterGraph& FilterGraph::add(const Node &node)
+    {
+        nodes.push_back(node);
+        planned_type = -1;
+        return *this;
+    }
+
+    static Node node(Op op, const std::string &name)
+    {
+        Node n;
+        n.op = op;
+        n.name = name;
+        return n;
+    }
+
+    FilterGraph& FilterGraph::grayscale()
+    {
+        return add(node(OP_GRAYSCALE, "grayscale"));
+    }
+
+    FilterGraph& FilterGraph::blur5x5()
+    {
+        return add(node(OP_BLUR, "blur5x5"));
+    }
+
+    FilterGraph& FilterGraph::sobelX3x3()
+    {
+        return add(node(OP_SOBEL_X, "sobelX3x3"));
+    }
+
+    FilterGraph& FilterGraph::sobelY3x3()
+    {
+        return add(node(OP_SOBEL_Y, "sobelY3x3"));
+    }
+
+    FilterGraph& FilterGraph::magnitude()
+    {
+        return add(node(OP_MAGNITUDE, "magnitude"));
+    }
+
+    FilterGraph& FilterGraph::convertToUchar()
+    {
+        return add(node(OP_ABS, "convertToUchar"));
+    }
+
+    FilterGraph& FilterGraph::negative()
+    {
+        return pointOp(pointop::negativeOp(), "negative");
+    }
+
+    FilterGraph& FilterGraph::orientation(int bins)
+    {
+        Node n = node(OP_ORIENTATION, "orientation");
+        n.bins = bins;
+        return add(n);
+    }
+
+    FilterGraph& FilterGraph::quantize(int levels)
+    {
+        // out of range levels are kept as an empty table and rejected by the plan
+        if (levels < 1 || levels > 255)
+        {
+            return add(node(OP_LUT, "quantize"));
+        }
+
+        return pointOp(pointop::quantizeOp(levels), "quantize");
+    }
+
+    FilterGraph& FilterGraph::pointOp(const pointop::PointOp &op, const std::string &name)
+    {
+        Node n = node(OP_LUT, name);
+        n.lut.assign(op.lut(), op.lut() + 256);
+        return add(n);
+    }
+
+    void FilterGraph::clear()
+    {
+        nodes.clear();
+        stages.clear();
+        report.clear();
+        planned_type = -1;
+    }
+
+    // the channel counts the separable sweeps are specialized for
+    static bool separableChannels(int cn)
+    {
+        return cn == 1 || cn == 3 || cn == 4;
+    }
+
+    // the stage running a node on its own, or halo -1 if the node does not accept the
+    // type it is given
+    static Stage stageFor(const Node &n, int type)
+    {
+        Stage s;
+        s.op = n.op;
+        s.name = n.name;
+        s.bins = n.bins;
+        s.halo = -1;
+
+        int depth = CV_MAT_DEPTH(type);
+        int cn = CV_MAT_CN(type);
+        switch (n.op)
+        {
+            case OP_GRAYSCALE:
+                if (type == CV_8UC3)
+                {
+                    s.halo = 0;
+                    s.out_type = CV_8UC1;
+                }
+                break;
+            case OP_BLUR:
+                if (depth == CV_8U && separableChannels(cn))
+                {
+                    s.halo = BLUR_HALO;
+                    s.out_type = type;
+                }
+                break;
+            case OP_SOBEL_X:
+            case OP_SOBEL_Y:
+                if (depth == CV_8U && separableChannels(cn))
+                {
+                    s.halo = SOBEL_HALO;
+                    s.out_type = CV_16SC(cn);
+                }
+                break;
+            case OP_MAGNITUDE:
+                if (depth == CV_8U)
+                {
+                    s.halo = SOBEL_HALO;
+                    s.out_type = type;
+                }
+                break;
+            case OP_ORIENTATION:
+                if (depth == CV_8U && n.bins >= 2 && n.bins <= 255)
+                {
+                    s.halo = SOBEL_HALO;
+                    s.out_type = CV_8UC1;
+                }
+                break;
+            case OP_ABS:
+                if (depth == CV_16S)
+                {
+                    s.halo = 0;
+                    s.out_type = CV_8UC(cn);
+                }
+                break;
+            case OP_LUT:
+                if (depth == CV_8U && n.lut.size() == 256)
+                {
+                    s.halo = 0;
+                    s.out_type = type;
+                    s.post = n.lut;
+                }
+                break;
+        }
+
+        return s;
+    }
+
+    int FilterGraph::plan(int type, int cols)
+    {
+        if (type == planned_type && cols == planned_cols)
+        {
+            return SUCCESS_CODE;
+        }
+
+        stages.clear();
+        report.clear();
+        planned_type = -1;
+        if (nodes.empty())
+        {
+            return ERROR_CODE;
+        }
+
+        char line[256];
+        int cur = type;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const Node &n = nodes[i];
+            Stage *last = stages.empty() ? nullptr : &stages.back();
+
+            // a lookup table is applied to each row of the stage before it as the row
+            // is produced, composed with any table already there
+            if (n.op == OP_LUT && n.lut.size() == 256 && last && CV_MAT_DEPTH(cur) == CV_8U)
+            {
+                if (last->post.empty())
+                {
+                    last->post = n.lut;
+                    snprintf(line, sizeof(line), "%s + %s: lookup applied to each row as it is produced",
+                        nodes[i - 1].name.c_str(), n.name.c_str());
+                }
+                else
+                {
+                    for (int v = 0; v < 256; v++)
+                    {
+                        last->post[v] = n.lut[last->post[v]];
+                    }
+                    snprintf(line, sizeof(line), "%s + %s: lookup tables composed into one",
+                        nodes[i - 1].name.c_str(), n.name.c_str());
+                }
+                report.push_back(line);
+                last->name += "+" + n.name;
+                continue;
+            }
+
+            // the absolute value of a Sobel row is taken before the row is stored
+            if (n.op == OP_ABS && last && (last->op == OP_SOBEL_X || last->op == OP_SOBEL_Y) && !last->abs_out)
+            {
+                last->abs_out = true;
+                last->out_type = CV_8UC(CV_MAT_CN(cur));
+                last->name += "+" + n.name;
+                cur = last->out_type;
+                snprintf(line, sizeof(line), "%s + %s: absolute value taken on each row as it is produced",
+                    nodes[i - 1].name.c_str(), n.name.c_str());
+                report.push_back(line);
+                continue;
+            }
+
+            Stage s = stageFor(n, cur);
+            if (s.halo < 0)
+            {
+                stages.clear();
+                report.clear();
+                return ERROR_CODE;
+            }
+            stages.push_back(s);
+            cur = s.out_type;
+        }
+
+        // the stages of a tile all run before the next tile starts
+        for (size_t i = 1; i < stages.size(); i++)
+        {
+            snprintf(line, sizeof(line), "%s -> %s: fused tile by tile",
+                stages[i - 1].name.c_str(), stages[i].name.c_str());
+            report.push_back(line);
+        }
+
+        // a single stage has no intermediates and runs over its whole band at once
+        tile_rows = 0;
+        if (stages.size() > 1)
+        {
+            size_t row_bytes = 0;
+            int halo = 0;
+            for (size_t i = 0; i + 1 < stages.size(); i++)
+            {
+                row_bytes += (size_t) cols * CV_ELEM_SIZE(stages[i].out_type);
+                halo += stages[i + 1].halo;
+            }
+            tile_rows = std::max(GRAPH_MIN_TILE_ROWS, (int) (GRAPH_TILE_BYTES / std::max<size_t>(row_bytes, 1)));
+
+            snprintf(line, sizeof(line), "tiles of %d rows, intermediates of %zu bytes, %d halo rows per tile edge",
+                tile_rows, row_bytes * (tile_rows + 2 * halo), halo);
+            report.push_back(line);
+        }
+
+        planned_type = type;
+        planned_cols = cols;
+        return SUCCESS_CODE;
+    }
+
+    // applies the stage's lookup table, if any, to a finished uchar row
+    static inline void finishRow(const Stage &s, uchar *row, int n)
+    {
+        if (!s.post.empty())
+        {
+            simd::lutRow(s.post.data(), row, row, n);
+        }
+    }
+
+    template <int CN>
+    static void blurRows(const Stage &s, cv::Mat &in, int in_a, cv::Mat &out, int out_a, int out_b)
+    {
+        int n = in.cols * CN;
+        conv::SeparableSweep<BlurTaps, BlurTaps, CN, uchar, uchar, 1, uchar> sweep(in, out_a - in_a);
+        for (int r = out_a; r < out_b; r++)
+        {
+            uchar *orow = out.ptr<uchar>(r - out_a);
+            sweep.row(r - in_a, orow);
+            finishRow(s, orow, n);
+        }
+    }
+
+    template <int CN, typename HTaps, typename VTaps>
+    static void sobelRows(const Stage &s, cv::Mat &in, int in_a, cv::Mat &out, int out_a, int out_b)
+    {
+        int n = in.cols * CN;
+        conv::SeparableSweep<HTaps, VTaps, CN, short, short, 4, uchar> sweep(in, out_a - in_a);
+        if (!s.abs_out)
+        {
+            for (int r = out_a; r < out_b; r++)
+            {
+                sweep.row(r - in_a, out.ptr<short>(r - out_a));
+            }
+            return;
+        }
+
+        pool::PooledMat response(1, n, CV_16SC1);
+        short *resp = (*response).ptr<short>(0);
+        for (int r = out_a; r < out_b; r++)
+        {
+            uchar *orow = out.ptr<uchar>(r - out_a);
+            sweep.row(r - in_a, resp);
+            simd::absRow(resp, orow, n);
+            finishRow(s, orow, n);
+        }
+    }
+
+    template <int CN>
+    static void separableStage(const Stage &s, cv::Mat &in, int in_a, cv::Mat &out, int out_a, int out_b)
+    {
+        if (s.op == OP_BLUR)
+        {
+            blurRows<CN>(s, in, in_a, out, out_a, out_b);
+        }
+        else if (s.op == OP_SOBEL_X)
+        {
+            sobelRows<CN, SobelDerivXTaps, SobelSmoothTaps>(s, in, in_a, out, out_a, out_b);
+        }
+        else
+        {
+            sobelRows<CN, SobelSmoothTaps, SobelDerivYTaps>(s, in, in_a, out, out_a, out_b);
+        }
+    }
+
+    static void gradientStage(const Stage &s, cv::Mat &in, int in_a, cv::Mat &out, int out_a, int out_b)
+    {
+        int n = in.cols * in.channels();
+        gradient::GradientSweep sweep(in, out_a - in_a);
+
+        pool::PooledMat sx_row(1, n, CV_16SC1);
+        pool::PooledMat sy_row(1, n, CV_16SC1);
+        short *sx = (*sx_row).ptr<short>(0);
+        short *sy = (*sy_row).ptr<short>(0);
+
+        for (int r = out_a; r < out_b; r++)
+        {
+            uchar *orow = out.ptr<uchar>(r - out_a);
+            sweep.row(r - in_a, sx, sy);
+            if (s.op == OP_MAGNITUDE)
+            {
+                gradient::magnitudeRow(sx, sy, orow, n);
+                finishRow(s, orow, n);
+            }
+            else
+            {
+                gradient::orientationRow(sx, sy, orow, in.cols, in.channels(), s.bins);
+                finishRow(s, orow, in.cols);
+            }
+        }
+    }
+
+    // runs a stage over the output rows [out_a, out_b). in holds the input rows from
+    // in_a on, including the halo the stage reads, and out holds exactly the output rows.
+    static void runStage(const Stage &s, cv::Mat &in, int in_a, cv::Mat &out, int out_a, int out_b)
+    {
+        int n = out.cols * out.channels();
+        switch (s.op)
+        {
+            case OP_GRAYSCALE:
+                cv::cvtColor(in.rowRange(out_a - in_a, out_b - in_a), out, cv::COLOR_BGR2GRAY);
+                for (int r = 0; r < out.rows; r++)
+                {
+                    finishRow(s, out.ptr<uchar>(r), n);
+                }
+                break;
+            case OP_BLUR:
+            case OP_SOBEL_X:
+            case OP_SOBEL_Y:
+                if (in.channels() == 1)
+                {
+                    separableStage<1>(s, in, in_a, out, out_a, out_b);
+                }
+                else if (in.channels() == 3)
+                {
+                    separableStage<3>(s, in, in_a, out, out_a, out_b);
+                }
+                else
+                {
+                    separableStage<4>(s, in, in_a, out, out_a, out_b);
+                }
+                break;
+            case OP_MAGNITUDE:
+            case OP_ORIENTATION:
+                gradientStage(s, in, in_a, out, out_a, out_b);
+                break;
+            case OP_ABS:
+                for (int r = out_a; r < out_b; r++)
+                {
+                    uchar *orow = out.ptr<uchar>(r - out_a);
+                    simd::absRow(in.ptr<short>(r - in_a), orow, n);
+                    finishRow(s, orow, n);
+                }
+                break;
+            case OP_LUT:
+                for (int r = out_a; r < out_b; r++)
+                {
+                    simd::lutRow(s.post.data(), in.ptr<uchar>(r - in_a), out.ptr<uchar>(r - out_a), n);
+                }
+                break;
+        }
+    }
+
+    void FilterGraph::runBand(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end)
+    {
+        int n_stages = (int) stages.size();
+
+        // the rows beyond a tile stage i must produce for the stages after it
+        std::vector<int> reach(n_stages, 0);
+        for (int i = n_stages - 2; i >= 0; i--)
+        {
+            reach[i] = reach[i + 1] + stages[i + 1].halo;
+        }
+
+        int tile = tile_rows > 0 ? tile_rows : std::max(1, row_end - row_begin);
+
+        // one tile of output for each stage but the last, which writes into dst
+        std::vector<std::unique_ptr<pool::PooledMat>> stripes;
+        for (int i = 0; i + 1 < n_stages; i++)
+        {
+            stripes.emplace_back(new pool::PooledMat(tile + 2 * reach[i], src.cols, stages[i].out_type));
+        }
+
+        for (int t0 = row_begin; t0 < row_end; t0 += tile)
+        {
+            int t1 = std::min(t0 + tile, row_end);
+
+            int in_a = std::max(0, t0 - reach[0] - stages[0].halo);
+            cv::Mat in = src.rowRange(in_a, std::min(src.rows, t1 + reach[0] + stages[0].halo));
+            for (int i = 0; i < n_stages; i++)
+            {
+                int out_a = std::max(0, t0 - reach[i]);
+                int out_b = std::min(src.rows, t1 + reach[i]);
+                cv::Mat out = i + 1 == n_stages ? dst.rowRange(out_a, out_b) : (**stripes[i]).rowRange(0, out_b - out_a);
+
+                runStage(stages[i], in, in_a, out, out_a, out_b);
+                in = out;
+                in_a = out_a;
+            }
+        }
+    }
+
+    int FilterGraph::validate(int type)
+    {
+        // the width only sizes the tiles, which run() plans again for its input
+        return plan(type, 1);
+    }
+
+    int FilterGraph::run(cv::Mat &src, cv::Mat &dst)
+    {
+        if (src.empty() || plan(src.type(), src.cols) != SUCCESS_CODE)
+        {
+            return ERROR_CODE;
+        }
+
+        // hold on to the source in case dst is the same cv::Mat and is reallocated
+        cv::Mat input = src;
+        dst.create(input.rows, input.cols, stages.back().out_type);
+
+        // in place, a tile would overwrite rows the next tile still reads as its halo
+        std::unique_ptr<pool::PooledMat> aside;
+        if (input.data == dst.data)
+        {
+            aside.reset(new pool::PooledMat(input.rows, input.cols, input.type()));
+            input.copyTo(**aside);
+            input = **aside;
+        }
+
+        exec::forEachBand(input.rows, [&](int row_begin, int row_end) {
+            runBand(input, dst, row_begin, row_end);
+        });
+
+        return SUCCESS_CODE;
+    }
+
+    int parseChain(const std::string &spec, FilterGraph &g)
+    {
+        size_t begin = 0;
+        while (begin <= spec.size())
+        {
+            size_t end = spec.find(',', begin);
+            if (end == std::string::npos)
+            {
+                end = spec.size();
+            }
+            std::string op = spec.substr(begin, end - begin);
+            begin = end + 1;
+
+            // an optional parameter follows a colon
+            int param = -1;
+            size_t colon = op.find(':');
+            if (colon != std::string::npos)
+            {
+                param = atoi(op.c_str() + colon + 1);
+                op = op.substr(0, colon);
+            }
+
+            if (op == "grayscale")
+            {
+                g.grayscale();
+            }
+            else if (op == "blur")
+            {
+                g.blur5x5();
+            }
+            else if (op == "sobelx")
+            {
+                g.sobelX3x3();
+            }
+            else if (op == "sobely")
+            {
+                g.sobelY3x3();
+            }
+            else if (op == "abs")
+            {
+                g.convertToUchar();
+            }
+            else if (op == "magnitude")
+            {
+                g.magnitude();
+            }
+            else if (op == "negative")
+            {
+                g.negative();
+            }
+            else if (op == "orientation" && (colon == std::string::npos || (param >= 2 && param <= 255)))
+            {
+                g.orientation(colon == std::string::npos ? DEFAULT_ORIENTATION_BINS : param);
+            }
+            else if (op == "quantize" && (colon == std::string::npos || (param >= 1 && param <= 255)))
+            {
+                g.quantize(colon == std::string::npos ? DEFAULT_LEVELS : param);
+            }
+            else
+            {
+                return ERROR_CODE;
+            }
+        }
+
+        return SUCCESS_CODE;
+    }
+}
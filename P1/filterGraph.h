@@ -0,0 +1,277 @@
+/**
+ * Header for the filter graph. A chain of filters is described first and run later,
+ * so the whole chain is known before any pixel is touched. Running it plans the chain
+ * into stages: point operations are folded into the stage before them, so they are
+ * applied to each row while it is still in cache, and consecutive lookup tables are
+ * composed into one. The stages then run tile by tile, each tile a band of rows
+ * carrying the halo rows its stencils need, so the intermediates between stages only
+ * ever hold one tile and never a full frame. Every fusion applied is reported.
+ */
+
+#ifndef P1_FILTER_GRAPH
+#define P1_FILTER_GRAPH
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pointOp.h"
+
+namespace graph
+{
+    // Enum defining the operations a FilterGraph can chain
+    enum Op {
+        // BGR to gray, as grayscale()
+        OP_GRAYSCALE,
+        // 5x5 Gaussian blur, as blur5x5()
+        OP_BLUR,
+        // 3x3 Sobel X to short, as sobelX3x3()
+        OP_SOBEL_X,
+        // 3x3 Sobel Y to short, as sobelY3x3()
+        OP_SOBEL_Y,
+        // gradient magnitude of the Sobel filters, as magnitudeFilter()
+        OP_MAGNITUDE,
+        // quantized gradient direction, as orientation()
+        OP_ORIENTATION,
+        // short to uchar absolute value, as convertToUchar()
+        OP_ABS,
+        // a uchar lookup table, e.g. negative() or the quantization of blurQuantize()
+        OP_LUT
+    };
+
+    /**
+     * One operation of a chain, as it was described.
+     */
+    struct Node
+    {
+        // the operation
+        Op op;
+
+        // the name the operation is reported under
+        std::string name;
+
+        // the number of direction bins, for OP_ORIENTATION
+        int bins = 0;
+
+        // the lookup table, for OP_LUT
+        std::vector<uchar> lut;
+    };
+
+    /**
+     * A unit of the planned chain: one operation with the point operations which
+     * follow it folded in.
+     */
+    struct Stage
+    {
+        // the operation producing the stage's rows
+        Op op;
+
+        // the names of the operations folded into the stage, joined with '+'
+        std::string name;
+
+        // the number of input rows above and below an output row the stage reads
+        int halo = 0;
+
+        // the OpenCV type of the stage's output
+        int out_type = 0;
+
+        // the number of direction bins, for OP_ORIENTATION
+        int bins = 0;
+
+        // is the short Sobel output converted to its uchar absolute value
+        bool abs_out = false;
+
+        // lookup table applied to each output row, empty for none
+        std::vector<uchar> post;
+    };
+
+    /**
+     * A chain of filters applied to an image as one fused operation.
+     */
+    class FilterGraph
+    {
+        private:
+            // the chain as described
+            std::vector<Node> nodes;
+
+            // the chain as planned for the last input
+            std::vector<Stage> stages;
+
+            // the type and width the stages were planned for, -1 when unplanned
+            int planned_type = -1;
+            int planned_cols = -1;
+
+            // the number of rows in each tile
+            int tile_rows = 0;
+
+            // the fusions applied by the last plan
+            std::vector<std::string> report;
+
+            /**
+             * Appends an operation to the chain and discards any plan.
+             *
+             * @param node the operation
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& add(const Node &node);
+
+            /**
+             * Plans the chain for an input, unless it is already planned for one of
+             * the same type and width.
+             *
+             * @param type the OpenCV type of the input
+             * @param cols the width of the input
+             *
+             * @return 0 for success, -1 if the chain is empty or an operation does not
+             *         accept the output of the one before it
+             */
+            int plan(int type, int cols);
+
+            /**
+             * Runs the planned stages over the output rows [row_begin, row_end), one
+             * tile at a time.
+             *
+             * @param src reference to the source image
+             * @param dst reference to the destination image
+             * @param row_begin the first output row
+             * @param row_end one past the last output row
+             */
+            void runBand(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end);
+
+        public:
+            /**
+             * Appends a grayscale() to the chain.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& grayscale();
+
+            /**
+             * Appends a blur5x5() to the chain.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& blur5x5();
+
+            /**
+             * Appends a sobelX3x3() to the chain. Its output is short.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& sobelX3x3();
+
+            /**
+             * Appends a sobelY3x3() to the chain. Its output is short.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& sobelY3x3();
+
+            /**
+             * Appends a magnitudeFilter() to the chain.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& magnitude();
+
+            /**
+             * Appends a convertToUchar() to the chain.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& convertToUchar();
+
+            /**
+             * Appends a negative() to the chain.
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& negative();
+
+            /**
+             * Appends an orientation() to the chain.
+             *
+             * @param bins the number of direction bins, 2 - 255
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& orientation(int bins);
+
+            /**
+             * Appends the quantization step of blurQuantize() to the chain, so
+             * blur5x5().quantize(levels) matches blurQuantize().
+             *
+             * @param levels the number of quantization levels, 1 - 255
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& quantize(int levels);
+
+            /**
+             * Appends an arbitrary point operation to the chain.
+             *
+             * @param op the point operation
+             * @param name the name to report it under
+             *
+             * @return reference to this graph
+             */
+            FilterGraph& pointOp(const pointop::PointOp &op, const std::string &name);
+
+            /**
+             * Removes every operation from the chain.
+             */
+            void clear();
+
+            /**
+             * Getter for the number of operations in the chain.
+             *
+             * @return the number of operations described
+             */
+            int size() const { return (int) nodes.size(); }
+
+            /**
+             * Checks the chain for an input type without running it.
+             *
+             * @param type the OpenCV type of the input, e.g. CV_8UC3
+             *
+             * @return 0 if every operation accepts the output of the one before it, -1
+             *         otherwise
+             */
+            int validate(int type);
+
+            /**
+             * Runs the chain, split into row bands on the exec thread pool. The
+             * result is identical to calling the filters one after another. The
+             * plan is kept for the next input of the same type and width.
+             *
+             * @param src reference to the source image
+             * @param dst reference to the destination image, allocated if needed. May
+             *            be src, in which case the source is copied aside first.
+             *
+             * @return 0 for success, -1 for failure
+             */
+            int run(cv::Mat &src, cv::Mat &dst);
+
+            /**
+             * Getter for the fusions applied by the last plan, one line each.
+             *
+             * @return the fusion report
+             */
+            const std::vector<std::string>& fusions() const { return report; }
+    };
+
+    /**
+     * Builds a chain from a comma separated list of operations, each optionally
+     * followed by a parameter after a colon, e.g. "blur,quantize:10,negative".
+     * The operations are grayscale, blur, sobelx, sobely, abs, magnitude,
+     * orientation[:bins], negative and quantize[:levels].
+     *
+     * @param spec the chain spec
+     * @param g the graph to append to
+     *
+     * @return 0 for success, -1 if an operation or parameter is unknown or invalid
+     */
+    int parseChain(const std::string &spec, FilterGraph &g);
+}
+
+#endif
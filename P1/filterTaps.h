@@ -0,0 +1,37 @@
+/**
+ * Header for the taps of the separable filters. The filters and the filter graph both
+ * sweep with these taps, so both see the vectorized row kernels the blur is routed
+ * to and instantiate identical sweeps.
+ */
+
+#ifndef P1_FILTER_TAPS
+#define P1_FILTER_TAPS
+
+#include <opencv2/opencv.hpp>
+#include "separable.h"
+#include "simd.h"
+
+typedef conv::Taps<conv::BORDER_CENTER, 10, 1, 2, 4, 2, 1> BlurTaps;
+typedef conv::Taps<conv::BORDER_ZERO, 1, -1, 0, 1> SobelDerivXTaps;
+typedef conv::Taps<conv::BORDER_ZERO, 1, 1, 0, -1> SobelDerivYTaps;
+typedef conv::Taps<conv::BORDER_ZERO, 1, 1, 2, 1> SobelSmoothTaps;
+
+namespace conv
+{
+    // blur rows run through the vectorized fixed-point kernels
+    template <int CN>
+    struct RowKernels<BlurTaps, BlurTaps, CN, uchar, uchar, 1>
+    {
+        static void horizontal(const BlurTaps &, const uchar *srow, uchar *brow, int cols)
+        {
+            simd::blurRowH(srow, brow, cols, CN);
+        }
+
+        static void vertical(const BlurTaps &, const uchar **rows, uchar *, uchar *drow, int n)
+        {
+            simd::blurRowV(rows, drow, n);
+        }
+    };
+}
+
+#endif
@@ -1,294 +1,486 @@
 #include <stdio.h>
 #include <opencv2/opencv.hpp>
 #include "filters.h"
+#include "simd.h"
+#include "gradient.h"
+#include "separable.h"
+#include "filterTaps.h"
+#include "exec.h"
+#include "bufferPool.h"
+#include "pointOp.h"
+#include "bilateral.h"
 
 #define ERROR_CODE -1
 #define SUCCESS_CODE 0
-#define BLUR_FILTER_SIZE 5
 #define SOBEL_FILTER_SIZE 3
 
 void convertToUchar(cv::Mat *src, cv::Mat *dst)
 {
-    for (int r = 0; r < src->rows; r++)
-    {
-        uchar *row = dst->ptr<uchar>(r);
-        for (int c = 0; c < src->cols; c++)
-        {
-            row[c * 3 + 0] = (uchar) abs(src->ptr<short>(r)[c * 3 + 0]);
-            row[c * 3 + 1] = (uchar) abs(src->ptr<short>(r)[c * 3 + 1]);
-            row[c * 3 + 2] = (uchar) abs(src->ptr<short>(r)[c * 3 + 2]);
-        }
-    }
+    pointop::absToUchar(*src, *dst);
 }
 
 void grayscale(cv::Mat *src, cv::Mat *dst)
 {
-    cv::cvtColor(*src, *dst, cv::COLOR_BGR2GRAY);
+    // a single channel image is already gray
+    if (src->channels() == 1)
+    {
+        src->copyTo(*dst);
+        return;
+    }
+
+    // allocate up front so each band converts straight into its rows of the output.
+    // In place, allocating dst would release src, so the bands convert into an image
+    // of their own which then replaces dst.
+    int code = src->channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY;
+    cv::Mat gray;
+    cv::Mat *out = dst;
+    if (src->data == dst->data)
+    {
+        out = &gray;
+    }
+    out->create(src->rows, src->cols, CV_8UC1);
+    exec::forEachBand(src->rows, [&](int row_begin, int row_end) {
+        cv::Mat out_band = out->rowRange(row_begin, row_end);
+        cv::cvtColor(src->rowRange(row_begin, row_end), out_band, code);
+    });
+
+    if (out != dst)
+    {
+        *dst = gray;
+    }
 }
 
 int blur5x5(cv::Mat &src, cv::Mat &dst)
 {
-    cv::Mat tmp = cv::Mat(dst.rows, dst.cols, dst.type(), 0.0);
-    int filter[BLUR_FILTER_SIZE] = {1, 2, 4, 2, 1};
-    int center_k = BLUR_FILTER_SIZE / 2;
-
-    for (int r = 0; r < src.rows; r++)
+    dst.create(src.rows, src.cols, src.type());
+    switch (src.depth())
     {
-        uchar *srow = src.ptr<uchar>(r);
-        uchar *trow = tmp.ptr<uchar>(r);
-
-        for (int c = 0; c < src.cols; c++)
-        {
-            uchar htmp[3] = {0, 0, 0};
-            uchar vtmp[3] = {0, 0, 0};
-
-            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
-            {
-                // horizontal
-                int col = c - (center_k - k);
-                if (col < 0 || col > src.cols - 1)
-                {
-                    col = c;
-                }
+        case CV_8U:
+            return conv::separableFilter<BlurTaps, BlurTaps, uchar, uchar, 1, uchar, uchar>(src, dst);
+        case CV_16U:
+            return conv::separableFilter<BlurTaps, BlurTaps, int, ushort, 1, ushort, ushort>(src, dst);
+        case CV_32F:
+            return conv::separableFilter<BlurTaps, BlurTaps, float, float, 1, float, float>(src, dst);
+    }
 
-                htmp[0] += srow[col * 3 + 0] * filter[k] / 10;
-                htmp[1] += srow[col * 3 + 1] * filter[k] / 10;
-                htmp[2] += srow[col * 3 + 2] * filter[k] / 10;
-            }
+    return ERROR_CODE;
+}
 
-            trow[c * 3 + 0] = htmp[0];
-            trow[c * 3 + 1] = htmp[1];
-            trow[c * 3 + 2] = htmp[2];
-        }
+// a Sobel filter dispatched on the depth of the source: uchar pixels give short
+// responses and float pixels give float responses
+template <typename HTaps, typename VTaps>
+static int sobelFilter(cv::Mat &src, cv::Mat &dst, HTaps h, VTaps v)
+{
+    switch (src.depth())
+    {
+        case CV_8U:
+            dst.create(src.rows, src.cols, CV_16SC(src.channels()));
+            return conv::separableFilter<HTaps, VTaps, short, short, 4, uchar, short>(src, dst, h, v);
+        case CV_32F:
+            dst.create(src.rows, src.cols, CV_32FC(src.channels()));
+            return conv::separableFilter<HTaps, VTaps, float, float, 4, float, float>(src, dst, h, v);
     }
 
-    for (int r = 0; r < src.rows; r++)
+    return ERROR_CODE;
+}
+
+int applySobel(cv::Mat &src, cv::Mat &dst, int *horiz_filter, int *vert_filter, int filter_size)
+{
+    if (filter_size != SOBEL_FILTER_SIZE)
     {
-        uchar *trow = tmp.ptr<uchar>(r);
-        uchar *drow = dst.ptr<uchar>(r);
+        return ERROR_CODE;
+    }
 
-        for (int c = 0; c < src.cols; c++)
-        {
-            uchar htmp[3] = {0, 0, 0};
-            uchar vtmp[3] = {0, 0, 0};
+    typedef conv::RuntimeTaps<conv::BORDER_ZERO, SOBEL_FILTER_SIZE> SobelTaps;
+    return sobelFilter(src, dst, SobelTaps(horiz_filter), SobelTaps(vert_filter));
+}
 
-            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
-            {
-                // vertical
-                int row = r - (center_k - k);
-                if (row < 0 || row > src.rows - 1)
-                {
-                    row = r;
-                }
+int sobelX3x3(cv::Mat &src, cv::Mat &dst)
+{
+    return sobelFilter(src, dst, SobelDerivXTaps(), SobelSmoothTaps());
+}
 
-                int row_offset = -(r - row) * src.cols * 3;
-                vtmp[0] += trow[(row_offset) + c * 3 + 0] * filter[k] / 10;
-                vtmp[1] += trow[(row_offset) + c * 3 + 1] * filter[k] / 10;
-                vtmp[2] += trow[(row_offset) + c * 3 + 2] * filter[k] / 10;
-            }
+int sobelY3x3(cv::Mat &src, cv::Mat &dst)
+{
+    return sobelFilter(src, dst, SobelSmoothTaps(), SobelDerivYTaps());
+}
 
-            drow[c * 3 + 0] = vtmp[0];
-            drow[c * 3 + 1] = vtmp[1];
-            drow[c * 3 + 2] = vtmp[2];
-        }
+void sobel(cv::Mat *src, cv::Mat *dst, char dim)
+{
+    if (dim == 'x')
+    {
+        sobelX3x3(*src, *dst);
+    }
+    else
+    {
+        sobelY3x3(*src, *dst);
     }
-
-    return SUCCESS_CODE;
 }
 
-int applySobel(cv::Mat &src, cv::Mat &dst, int *horiz_filter, int *vert_filter, int filter_size)
+int magnitude(cv::Mat &sx, cv::Mat &sy, cv::Mat &dst)
 {
-    cv::Mat tmp = cv::Mat(dst.rows, dst.cols, dst.type(), 0.0);
-    for (int r = 0; r < src.rows; r++)
+    if (sx.type() != sy.type() || sx.size() != sy.size() || (sx.depth() != CV_16S && sx.depth() != CV_32F))
     {
-        uchar *srow = src.ptr<uchar>(r);
-        short *trow = tmp.ptr<short>(r);
-        for (int c = 0; c < src.cols; c++)
-        {
-            short htmp[3] = {0, 0, 0};
+        return ERROR_CODE;
+    }
 
-            int center_k = filter_size / 2;
-            for (int k = 0; k < SOBEL_FILTER_SIZE; k++)
+    int n = sx.cols * sx.channels();
+    if (sx.depth() == CV_32F)
+    {
+        dst.create(sx.rows, sx.cols, sx.type());
+        exec::forEachBand(sx.rows, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
             {
-                // horizontal
-                int col = c - (center_k - k);
-                if (col < 0 || col > src.cols - 1)
-                {
-                    continue;
-                }
-
-                htmp[0] += ((short) srow[col * 3 + 0]) * horiz_filter[k];
-                htmp[1] += ((short) srow[col * 3 + 1]) * horiz_filter[k];
-                htmp[2] += ((short) srow[col * 3 + 2]) * horiz_filter[k];
+                gradient::magnitudeRow(sx.ptr<float>(r), sy.ptr<float>(r), dst.ptr<float>(r), n);
             }
-
-            trow[c * 3 + 0] = htmp[0];
-            trow[c * 3 + 1] = htmp[1];
-            trow[c * 3 + 2] = htmp[2];
-        }
+        });
+        return SUCCESS_CODE;
     }
 
-    for (int r = 0; r < src.rows; r++)
-    {
-        short *trow = tmp.ptr<short>(r);
-        short *drow = dst.ptr<short>(r);
-        for (int c = 0; c < src.cols; c++)
+    dst.create(sx.rows, sx.cols, CV_8UC(sx.channels()));
+    exec::forEachBand(sx.rows, [&](int row_begin, int row_end) {
+        for (int r = row_begin; r < row_end; r++)
         {
-            short vtmp[3] = {0, 0, 0};
+            gradient::magnitudeRow(sx.ptr<short>(r), sy.ptr<short>(r), dst.ptr<uchar>(r), n);
+        }
+    });
 
-            int center_k = filter_size / 2;
-            for (int k = 0; k < SOBEL_FILTER_SIZE; k++)
-            {
-                // vertical
-                int row = r - (center_k - k);
-                if (row < 0 || row > src.rows - 1)
-                {
-                    continue;
-                }
+    return SUCCESS_CODE;
+}
 
-                int row_offset = -(r - row) * src.cols * 3;
+void magnitudeFilter(cv::Mat *src, cv::Mat *dst)
+{
+    gradient::GradientOutputs out;
+    out.mag = dst;
+    gradient::computeGradients(*src, out);
+}
 
-                vtmp[0] += trow[(row_offset) + c * 3 + 0] * vert_filter[k];
-                vtmp[1] += trow[(row_offset) + c * 3 + 1] * vert_filter[k];
-                vtmp[2] += trow[(row_offset) + c * 3 + 2] * vert_filter[k];
-            }
+int blurQuantize(cv::Mat &src, cv::Mat &dst, int levels)
+{
+    if (levels < 1 || levels > 255)
+    {
+        return ERROR_CODE;
+    }
 
-            drow[c * 3 + 0] = vtmp[0] / 4;
-            drow[c * 3 + 1] = vtmp[1] / 4;
-            drow[c * 3 + 2] = vtmp[2] / 4;
-        }
+    if (blur5x5(src, dst) != SUCCESS_CODE)
+    {
+        return ERROR_CODE;
     }
 
-    return SUCCESS_CODE;
+    return pointop::quantizeOp(levels).apply(dst, dst);
 }
 
-int sobelX3x3(cv::Mat &src, cv::Mat &dst)
+int negative(cv::Mat &src, cv::Mat &dst)
 {
-    int horiz_filter[SOBEL_FILTER_SIZE] = {-1, 0, 1};
-    int vert_filter[SOBEL_FILTER_SIZE] = {1, 2, 1};
-    return applySobel(src, dst, horiz_filter, vert_filter, SOBEL_FILTER_SIZE);
+    return pointop::negativeOp().apply(src, dst);
 }
 
-int sobelY3x3(cv::Mat &src, cv::Mat &dst)
+// one band of the fused cartoon kernel on CN channel rows. Each source row is streamed
+// through the blur and gradient sweeps, and the blurred row is quantized and masked while still in cache.
+template <int CN>
+static void cartoonRows(
+    cv::Mat &src, cv::Mat &dst, const pointop::PointOp &quantize, int magThreshold, int row_begin, int row_end)
 {
-    int horiz_filter[SOBEL_FILTER_SIZE] = {1, 2, 1};
-    int vert_filter[SOBEL_FILTER_SIZE] = {1, 0, -1};
-    return applySobel(src, dst, horiz_filter, vert_filter, SOBEL_FILTER_SIZE);
+    int n = src.cols * CN;
+    conv::SeparableSweep<BlurTaps, BlurTaps, CN, uchar, uchar, 1, uchar> blur(src, row_begin);
+    gradient::GradientSweep grad(src, row_begin);
+
+    pool::PooledMat sx_row(1, n, CV_16SC1);
+    pool::PooledMat sy_row(1, n, CV_16SC1);
+    pool::PooledMat mag_row(1, n, CV_8UC1);
+    short *sx = (*sx_row).ptr<short>(0);
+    short *sy = (*sy_row).ptr<short>(0);
+    uchar *mag = (*mag_row).ptr<uchar>(0);
+
+    for (int r = row_begin; r < row_end; r++)
+    {
+        // the gradient sweep reads row r + 1 of src, so in place the blurred row
+        // must not be written until it has
+        grad.row(r, sx, sy);
+        gradient::magnitudeRow(sx, sy, mag, n);
+
+        uchar *drow = dst.ptr<uchar>(r);
+        blur.row(r, drow);
+        pointop::lutMaskRow(quantize.lut(), drow, mag, drow, n, magThreshold);
+    }
 }
 
-void sobel(cv::Mat *src, cv::Mat *dst, char dim)
+// one band of the fused cartoon kernel for any supported channel count
+static void cartoonBand(
+    cv::Mat &src, cv::Mat &dst, const pointop::PointOp &quantize, int magThreshold, int row_begin, int row_end)
 {
-    if (dim == 'x')
+    switch (src.channels())
     {
-        sobelX3x3(*src, *dst);
+        case 1:
+            cartoonRows<1>(src, dst, quantize, magThreshold, row_begin, row_end);
+            break;
+        case 3:
+            cartoonRows<3>(src, dst, quantize, magThreshold, row_begin, row_end);
+            break;
+        case 4:
+            cartoonRows<4>(src, dst, quantize, magThreshold, row_begin, row_end);
+            break;
     }
-    else
+}
+
+int cartoon(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold)
+{
+    int cn = src.channels();
+    if (levels < 1 || levels > 255 || src.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4))
     {
-        sobelY3x3(*src, *dst);
+        return ERROR_CODE;
     }
+
+    pointop::PointOp quantize = pointop::quantizeOp(levels);
+    if (src.data == dst.data)
+    {
+        cartoonBand(src, dst, quantize, magThreshold, 0, src.rows);
+        return SUCCESS_CODE;
+    }
+
+    exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+        cartoonBand(src, dst, quantize, magThreshold, row_begin, row_end);
+    });
+
+    return SUCCESS_CODE;
 }
 
-int magnitude(cv::Mat &sx, cv::Mat &sy, cv::Mat &dst)
+// one band of the edge-preserving cartoon. The smoothed rows are quantized and masked
+// by the gradient of the source, as cartoonRows() does with the blurred rows.
+static void cartoonMaskRows(
+    cv::Mat &src, cv::Mat &smooth, cv::Mat &dst, const pointop::PointOp &quantize, int magThreshold,
+    int row_begin, int row_end)
 {
-    for (int r = 0; r < sx.rows; r++)
+    int n = src.cols * src.channels();
+    gradient::GradientSweep grad(src, row_begin);
+
+    pool::PooledMat sx_row(1, n, CV_16SC1);
+    pool::PooledMat sy_row(1, n, CV_16SC1);
+    pool::PooledMat mag_row(1, n, CV_8UC1);
+    short *sx = (*sx_row).ptr<short>(0);
+    short *sy = (*sy_row).ptr<short>(0);
+    uchar *mag = (*mag_row).ptr<uchar>(0);
+
+    for (int r = row_begin; r < row_end; r++)
     {
-        short *sxrow = sx.ptr<short>(r);
-        short *syrow = sy.ptr<short>(r);
+        // as in cartoonRows(), row r of dst is only written once the sweep has read
+        // row r + 1 of src
+        grad.row(r, sx, sy);
+        gradient::magnitudeRow(sx, sy, mag, n);
+
         uchar *drow = dst.ptr<uchar>(r);
-        for (int c = 0; c < sx.cols; c++)
-        {
-            short *pixel_sx = &sxrow[c * 3];
-            short *pixel_sy = &syrow[c * 3];
-            drow[3 * c + 0] = sqrt(pixel_sx[0] * pixel_sx[0] + pixel_sy[0] * pixel_sy[0]);
-            drow[3 * c + 1] = sqrt(pixel_sx[1] * pixel_sx[1] + pixel_sy[1] * pixel_sy[1]);
-            drow[3 * c + 2] = sqrt(pixel_sx[2] * pixel_sx[2] + pixel_sy[2] * pixel_sy[2]);
-        }
+        pointop::lutMaskRow(quantize.lut(), smooth.ptr<uchar>(r), mag, drow, n, magThreshold);
+    }
+}
+
+int cartoonBilateral(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold, int sigmaSpace, int sigmaRange)
+{
+    int cn = src.channels();
+    if (levels < 1 || levels > 255 || src.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4))
+    {
+        return ERROR_CODE;
     }
 
+    pool::PooledMat smooth(src.rows, src.cols, src.type());
+    if (bilateral::bilateralGrid(src, *smooth, sigmaSpace, sigmaRange) != SUCCESS_CODE)
+    {
+        return ERROR_CODE;
+    }
+
+    pointop::PointOp quantize = pointop::quantizeOp(levels);
+    dst.create(src.rows, src.cols, src.type());
+    if (src.data == dst.data)
+    {
+        cartoonMaskRows(src, *smooth, dst, quantize, magThreshold, 0, src.rows);
+        return SUCCESS_CODE;
+    }
+
+    exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+        cartoonMaskRows(src, *smooth, dst, quantize, magThreshold, row_begin, row_end);
+    });
+
     return SUCCESS_CODE;
 }
 
-void magnitudeFilter(cv::Mat *src, cv::Mat *dst)
+// the gradient magnitude of the luma of a color image, a single channel. The
+// gradient sweep then runs over one channel instead of three.
+static int lumaMagnitude(cv::Mat &src, cv::Mat &mag)
 {
-    cv::Mat sx = cv::Mat(src->rows, src->cols, CV_16SC3, 0.0);
-    cv::Mat sy = cv::Mat(src->rows, src->cols, CV_16SC3, 0.0);
-    sobel(src, &sx, 'x');
-    sobel(src, &sy, 'y');
-    magnitude(sx, sy, *dst);
+    pool::PooledMat gray(src.rows, src.cols, CV_8UC1);
+    grayscale(&src, gray.get());
+
+    gradient::GradientOutputs out;
+    out.mag = &mag;
+    return gradient::computeGradients(*gray, out);
 }
 
-int blurQuantize(cv::Mat &src, cv::Mat &dst, int levels)
+// copies each value of a single channel image into every channel of a CN channel image
+template <int CN>
+static void broadcastRows(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end)
 {
-    blur5x5(src, dst);
- 
-    int b = 255/levels;
-    for (int r = 0; r < src.rows; r++)
+    for (int r = row_begin; r < row_end; r++)
     {
-        uchar *row = dst.ptr<uchar>(r);
+        const uchar *srow = src.ptr<uchar>(r);
+        uchar *drow = dst.ptr<uchar>(r);
         for (int c = 0; c < src.cols; c++)
         {
-            row[c * 3 + 0] = (row[c * 3 + 0] / b) * b;
-            row[c * 3 + 1] = (row[c * 3 + 1] / b) * b;
-            row[c * 3 + 2] = (row[c * 3 + 2] / b) * b;
+            for (int k = 0; k < CN; k++)
+            {
+                drow[c * CN + k] = srow[c];
+            }
         }
     }
-
-    return SUCCESS_CODE;
 }
 
-int negative(cv::Mat &src, cv::Mat &dst)
+int magnitudeLuma(cv::Mat &src, cv::Mat &dst)
 {
-    for (int r = 0; r < src.rows; r++)
+    int cn = src.channels();
+    if (src.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4))
     {
-        uchar *drow = dst.ptr<uchar>(r);
-        uchar *srow = src.ptr<uchar>(r);
-        for (int c = 0; c < src.cols; c++)
+        return ERROR_CODE;
+    }
+
+    // a gray image is its own luma
+    if (cn == 1)
+    {
+        dst.create(src.rows, src.cols, src.type());
+        magnitudeFilter(&src, &dst);
+        return SUCCESS_CODE;
+    }
+
+    pool::PooledMat mag(src.rows, src.cols, CV_8UC1);
+    if (lumaMagnitude(src, *mag) != SUCCESS_CODE)
+    {
+        return ERROR_CODE;
+    }
+
+    dst.create(src.rows, src.cols, src.type());
+    exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+        if (cn == 3)
         {
-            drow[c * 3 + 0] = 255 - srow[c * 3 + 0];
-            drow[c * 3 + 1] = 255 - srow[c * 3 + 1];
-            drow[c * 3 + 2] = 255 - srow[c * 3 + 2];
+            broadcastRows<3>(*mag, dst, row_begin, row_end);
         }
-    }
+        else
+        {
+            broadcastRows<4>(*mag, dst, row_begin, row_end);
+        }
+    });
 
     return SUCCESS_CODE;
 }
 
-int cartoon(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold)
+// one band of the luma cartoon on CN channel rows. The blurred row is quantized as in
+// cartoonRows(), and a pixel whose luma magnitude is above the threshold is drawn black
+// in every channel.
+template <int CN>
+static void cartoonLumaRows(
+    cv::Mat &src, cv::Mat &mag, cv::Mat &dst, const pointop::PointOp &quantize, int magThreshold,
+    int row_begin, int row_end)
 {
-    cv::Mat grad_mag = cv::Mat(src.rows, src.cols, src.type(), 0.0);
-    magnitudeFilter(&src, &grad_mag);
-    blurQuantize(src, dst, levels);
-    for (int r = 0; r < dst.rows; r++)
+    int n = src.cols * CN;
+    conv::SeparableSweep<BlurTaps, BlurTaps, CN, uchar, uchar, 1, uchar> blur(src, row_begin);
+
+    for (int r = row_begin; r < row_end; r++)
     {
+        const uchar *mrow = mag.ptr<uchar>(r);
         uchar *drow = dst.ptr<uchar>(r);
-        uchar *gmrow = grad_mag.ptr<uchar>(r);
-        for (int c = 0; c < dst.cols; c++)
+        blur.row(r, drow);
+        simd::lutRow(quantize.lut(), drow, drow, n);
+        for (int c = 0; c < src.cols; c++)
         {
-            uchar *dpixel = &drow[c * 3];
-            uchar *gmpixel = &gmrow[c * 3];
-            if (gmpixel[0] > magThreshold)
+            if (mrow[c] > magThreshold)
             {
-                dpixel[0] = 0;
-            }
-            if (gmpixel[1] > magThreshold)
-            {
-                dpixel[1] = 0;
-            }
-            if (gmpixel[2] > magThreshold)
-            {
-                dpixel[2] = 0;
+                for (int k = 0; k < CN; k++)
+                {
+                    drow[c * CN + k] = 0;
+                }
             }
         }
     }
+}
+
+// one band of the luma cartoon for any supported channel count
+static void cartoonLumaBand(
+    cv::Mat &src, cv::Mat &mag, cv::Mat &dst, const pointop::PointOp &quantize, int magThreshold,
+    int row_begin, int row_end)
+{
+    if (src.channels() == 3)
+    {
+        cartoonLumaRows<3>(src, mag, dst, quantize, magThreshold, row_begin, row_end);
+    }
+    else
+    {
+        cartoonLumaRows<4>(src, mag, dst, quantize, magThreshold, row_begin, row_end);
+    }
+}
+
+int cartoonLuma(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold)
+{
+    int cn = src.channels();
+    if (levels < 1 || levels > 255 || src.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4))
+    {
+        return ERROR_CODE;
+    }
+
+    // a gray image is its own luma
+    if (cn == 1)
+    {
+        dst.create(src.rows, src.cols, src.type());
+        return cartoon(src, dst, levels, magThreshold);
+    }
+
+    // the edges are found before any row of dst is written, so in place only the
+    // blur's own rolling rows have to be respected
+    pool::PooledMat mag(src.rows, src.cols, CV_8UC1);
+    if (lumaMagnitude(src, *mag) != SUCCESS_CODE)
+    {
+        return ERROR_CODE;
+    }
+
+    pointop::PointOp quantize = pointop::quantizeOp(levels);
+    dst.create(src.rows, src.cols, src.type());
+    if (src.data == dst.data)
+    {
+        cartoonLumaBand(src, *mag, dst, quantize, magThreshold, 0, src.rows);
+        return SUCCESS_CODE;
+    }
+
+    exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+        cartoonLumaBand(src, *mag, dst, quantize, magThreshold, row_begin, row_end);
+    });
 
     return SUCCESS_CODE;
 }
 
-void orientation(cv::Mat *src, cv::Mat *dst)
+// one band of the orientation map, binned straight from the gradient sweep
+static void orientationRows(cv::Mat &src, cv::Mat &dst, int bins, int row_begin, int row_end)
+{
+    int n = src.cols * src.channels();
+    gradient::GradientSweep grad(src, row_begin);
+
+    pool::PooledMat sx_row(1, n, CV_16SC1);
+    pool::PooledMat sy_row(1, n, CV_16SC1);
+    short *sx = (*sx_row).ptr<short>(0);
+    short *sy = (*sy_row).ptr<short>(0);
+
+    for (int r = row_begin; r < row_end; r++)
+    {
+        grad.row(r, sx, sy);
+        gradient::orientationRow(sx, sy, dst.ptr<uchar>(r), src.cols, src.channels(), bins);
+    }
+}
+
+int orientation(cv::Mat *src, cv::Mat *dst, int bins)
 {
-    cv::Mat sx = cv::Mat(src->rows, src->cols, CV_16SC3, 0.0);
-    cv::Mat sy = cv::Mat(src->rows, src->cols, CV_16SC3, 0.0);
-    sobel(src, &sx, 'x');
-    sobel(src, &sy, 'y');
-    cv::Canny(sx, sy, *dst, 0, 15);
-}
\ No newline at end of file
+    if (bins < 2 || bins > 255 || src->depth() != CV_8U || src->data == dst->data)
+    {
+        return ERROR_CODE;
+    }
+
+    dst->create(src->rows, src->cols, CV_8UC1);
+    exec::forEachBand(src->rows, [&](int row_begin, int row_end) {
+        orientationRows(*src, *dst, bins, row_begin, row_end);
+    });
+
+    return SUCCESS_CODE;
+}
@@ -9,7 +9,10 @@ int sobelY3x3(cv::Mat &src, cv::Mat &dst);
 void sobel(cv::Mat *src, cv::Mat *dst, char dim);
 int magnitude(cv::Mat &sx, cv::Mat &sy, cv::Mat &dst);
 void magnitudeFilter(cv::Mat *src, cv::Mat *dst);
+int magnitudeLuma(cv::Mat &src, cv::Mat &dst);
 int blurQuantize(cv::Mat &src, cv::Mat &dst, int levels);
 int negative(cv::Mat &src, cv::Mat &dst);
 int cartoon(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold);
-void orientation(cv::Mat *src, cv::Mat *dst);
\ No newline at end of file
+int cartoonLuma(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold);
+int cartoonBilateral(cv::Mat &src, cv::Mat &dst, int levels, int magThreshold, int sigmaSpace, int sigmaRange);
+int orientation(cv::Mat *src, cv::Mat *dst, int bins);
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "frameSource.h"
+
+// the frame rate of recorded sources which do not carry one
+#define DEFAULT_FPS 30
+
+namespace source
+{
+    CameraSource::CameraSource(int index): cap(index)
+    {}
+
+    bool CameraSource::isOpened()
+    {
+        return cap.isOpened();
+    }
+
+    cv::Size CameraSource::size()
+    {
+        return cv::Size((int) cap.get(cv::CAP_PROP_FRAME_WIDTH), (int) cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    }
+
+    bool CameraSource::read(cv::Mat &frame, double *timestamp_ms)
+    {
+        cap >> frame;
+        if (frame.empty())
+        {
+            return false;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (!started)
+        {
+            start = now;
+            started = true;
+        }
+        *timestamp_ms = std::chrono::duration<double, std::milli>(now - start).count();
+
+        return true;
+    }
+
+    VideoFileSource::VideoFileSource(const std::string &path): cap(path), fps(DEFAULT_FPS)
+    {
+        double file_fps = cap.get(cv::CAP_PROP_FPS);
+        if (file_fps > 0)
+        {
+            fps = file_fps;
+        }
+    }
+
+    bool VideoFileSource::isOpened()
+    {
+        return cap.isOpened();
+    }
+
+    cv::Size VideoFileSource::size()
+    {
+        return cv::Size((int) cap.get(cv::CAP_PROP_FRAME_WIDTH), (int) cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+    }
+
+    bool VideoFileSource::read(cv::Mat &frame, double *timestamp_ms)
+    {
+        cap >> frame;
+        if (frame.empty())
+        {
+            return false;
+        }
+
+        // containers which do not report positions fall back to the nominal rate
+        double ms = cap.get(cv::CAP_PROP_POS_MSEC);
+        if (seq > 0 && ms <= last_ms)
+        {
+            ms = seq * 1000 / fps;
+        }
+        last_ms = ms;
+        seq++;
+        *timestamp_ms = ms;
+
+        return true;
+    }
+
+    ImageSequenceSource::ImageSequenceSource(const std::string &dir, double f): fps(f)
+    {
+        cv::glob(dir + "/*", files, false);
+
+        // the first readable image sets the size of the stream
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            cv::Mat img = cv::imread(files[i], cv::IMREAD_COLOR);
+            if (!img.empty())
+            {
+                first_size = img.size();
+                break;
+            }
+        }
+    }
+
+    bool ImageSequenceSource::isOpened()
+    {
+        return first_size.area() > 0;
+    }
+
+    cv::Size ImageSequenceSource::size()
+    {
+        return first_size;
+    }
+
+    bool ImageSequenceSource::read(cv::Mat &frame, double *timestamp_ms)
+    {
+        // files which are not images are skipped
+        for (; next < files.size(); next++)
+        {
+            frame = cv::imread(files[next], cv::IMREAD_COLOR);
+            if (!frame.empty())
+            {
+                break;
+            }
+        }
+        if (next == files.size())
+        {
+            return false;
+        }
+
+        next++;
+        *timestamp_ms = seq * 1000 / fps;
+        seq++;
+
+        return true;
+    }
+
+    MemorySource::MemorySource(const uchar *d, int n, cv::Size s, int t, double f):
+        data(d),
+        n_frames(n),
+        frame_size(s),
+        type(t),
+        fps(f)
+    {}
+
+    MemorySource::MemorySource(std::vector<uchar> &&d, cv::Size s, int t, double f):
+        owned(std::move(d)),
+        data(owned.data()),
+        n_frames(0),
+        frame_size(s),
+        type(t),
+        fps(f)
+    {
+        size_t frame_bytes = (size_t) s.area() * CV_ELEM_SIZE(t);
+        n_frames = frame_bytes > 0 ? (int) (owned.size() / frame_bytes) : 0;
+    }
+
+    bool MemorySource::isOpened()
+    {
+        return n_frames > 0;
+    }
+
+    cv::Size MemorySource::size()
+    {
+        return frame_size;
+    }
+
+    bool MemorySource::read(cv::Mat &frame, double *timestamp_ms)
+    {
+        if (seq == n_frames)
+        {
+            return false;
+        }
+
+        size_t frame_bytes = (size_t) frame_size.area() * CV_ELEM_SIZE(type);
+        cv::Mat(frame_size, type, (void *) (data + seq * frame_bytes)).copyTo(frame);
+        *timestamp_ms = seq * 1000 / fps;
+        seq++;
+
+        return true;
+    }
+
+    static Clock::duration fromMs(double ms)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    }
+
+    ReplaySource::ReplaySource(FrameSource *s, Replay m): inner(s), mode(m)
+    {}
+
+    ReplaySource::~ReplaySource()
+    {
+        delete inner;
+    }
+
+    bool ReplaySource::isOpened()
+    {
+        return inner->isOpened();
+    }
+
+    cv::Size ReplaySource::size()
+    {
+        return inner->size();
+    }
+
+    bool ReplaySource::read(cv::Mat &frame, double *timestamp_ms)
+    {
+        if (!inner->read(frame, timestamp_ms))
+        {
+            return false;
+        }
+        if (mode == REPLAY_FAST)
+        {
+            return true;
+        }
+
+        // the first frame anchors the recorded timeline to the wall clock
+        if (!started)
+        {
+            start = Clock::now() - fromMs(*timestamp_ms);
+            started = true;
+        }
+        std::this_thread::sleep_until(start + fromMs(*timestamp_ms));
+
+        return true;
+    }
+
+    // splits "a:b:c" into its fields
+    static std::vector<std::string> specFields(const std::string &spec)
+    {
+        std::vector<std::string> fields;
+        size_t begin = 0;
+        for (;;)
+        {
+            size_t end = spec.find(':', begin);
+            fields.push_back(spec.substr(begin, end - begin));
+            if (end == std::string::npos)
+            {
+                return fields;
+            }
+            begin = end + 1;
+        }
+    }
+
+    static FrameSource* openRaw(const std::vector<std::string> &fields)
+    {
+        int width = 0;
+        int height = 0;
+        if (fields.size() < 3 || sscanf(fields[2].c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+        {
+            return nullptr;
+        }
+        double fps = fields.size() > 3 ? atof(fields[3].c_str()) : DEFAULT_FPS;
+        if (fps <= 0)
+        {
+            return nullptr;
+        }
+
+        std::ifstream file(fields[1], std::ios::binary);
+        std::vector<uchar> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        return new MemorySource(std::move(bytes), cv::Size(width, height), CV_8UC3, fps);
+    }
+
+    FrameSource* openSource(const std::string &spec, Replay mode)
+    {
+        std::vector<std::string> fields = specFields(spec);
+        const std::string &kind = fields[0];
+
+        if (kind == "camera")
+        {
+            int index = fields.size() > 1 ? atoi(fields[1].c_str()) : 0;
+            return new CameraSource(index);
+        }
+
+        FrameSource *recorded = nullptr;
+        if (kind == "video" && fields.size() > 1)
+        {
+            // the path itself may contain colons
+            recorded = new VideoFileSource(spec.substr(kind.size() + 1));
+        }
+        else if (kind == "images" && fields.size() > 1)
+        {
+            double fps = fields.size() > 2 ? atof(fields[2].c_str()) : DEFAULT_FPS;
+            if (fps <= 0)
+            {
+                return nullptr;
+            }
+            recorded = new ImageSequenceSource(fields[1], fps);
+        }
+        else if (kind == "raw")
+        {
+            recorded = openRaw(fields);
+        }
+
+        if (!recorded)
+        {
+            return nullptr;
+        }
+
+        return new ReplaySource(recorded, mode);
+    }
+}
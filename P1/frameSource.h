@@ -0,0 +1,265 @@
+/**
+ * Header for the frame sources VidDisplay reads from. A source may be a camera, a
+ * video file, a directory of images or frames already in memory. Recorded sources can
+ * be replayed at their recorded timestamps or as fast as they decode, so the live
+ * filter path can be exercised without a camera.
+ */
+
+#ifndef P1_FRAME_SOURCE
+#define P1_FRAME_SOURCE
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace source
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Enum defining how a recorded source paces its frames
+    enum Replay {
+        REPLAY_REALTIME,
+        REPLAY_FAST
+    };
+
+    /**
+     * A stream of frames.
+     */
+    class FrameSource
+    {
+        public:
+            virtual ~FrameSource() {}
+
+            /**
+             * Getter for whether the source opened successfully.
+             *
+             * @return true if frames can be read
+             */
+            virtual bool isOpened() = 0;
+
+            /**
+             * Getter for the size of the frames.
+             *
+             * @return the frame size
+             */
+            virtual cv::Size size() = 0;
+
+            /**
+             * Reads the next frame.
+             *
+             * @param frame the image to fill
+             * @param timestamp_ms set to the time of the frame in the stream, in ms from
+             *                     the first frame
+             *
+             * @return false once the source has no more frames
+             */
+            virtual bool read(cv::Mat &frame, double *timestamp_ms) = 0;
+    };
+
+    /**
+     * Frames from a camera, timestamped as they arrive.
+     */
+    class CameraSource: public FrameSource
+    {
+        private:
+            // the camera
+            cv::VideoCapture cap;
+
+            // when the first frame was read
+            Clock::time_point start;
+
+            // has a frame been read yet
+            bool started = false;
+
+        public:
+            /**
+             * Primary constructor for the CameraSource.
+             *
+             * @param index the index of the camera device
+             */
+            explicit CameraSource(int index);
+
+            bool isOpened() override;
+            cv::Size size() override;
+            bool read(cv::Mat &frame, double *timestamp_ms) override;
+    };
+
+    /**
+     * Frames decoded from a video file, timestamped with their position in the file.
+     */
+    class VideoFileSource: public FrameSource
+    {
+        private:
+            // the video file
+            cv::VideoCapture cap;
+
+            // the nominal frame rate, for files which report no positions
+            double fps;
+
+            // the index of the next frame
+            long seq = 0;
+
+            // the timestamp of the previous frame
+            double last_ms = -1;
+
+        public:
+            /**
+             * Primary constructor for the VideoFileSource.
+             *
+             * @param path the path of the video file
+             */
+            explicit VideoFileSource(const std::string &path);
+
+            bool isOpened() override;
+            cv::Size size() override;
+            bool read(cv::Mat &frame, double *timestamp_ms) override;
+    };
+
+    /**
+     * Frames read from the images in a directory, in name order, at a fixed rate.
+     */
+    class ImageSequenceSource: public FrameSource
+    {
+        private:
+            // the image paths
+            std::vector<std::string> files;
+
+            // the rate the sequence was recorded at
+            double fps;
+
+            // the index of the next file
+            size_t next = 0;
+
+            // the index of the next frame
+            long seq = 0;
+
+            // the size of the first image
+            cv::Size first_size;
+
+        public:
+            /**
+             * Primary constructor for the ImageSequenceSource.
+             *
+             * @param dir the directory of images
+             * @param f the frame rate to timestamp the images at
+             */
+            ImageSequenceSource(const std::string &dir, double f);
+
+            bool isOpened() override;
+            cv::Size size() override;
+            bool read(cv::Mat &frame, double *timestamp_ms) override;
+    };
+
+    /**
+     * Frames held back to back in a block of memory, at a fixed rate. Reading copies a
+     * frame out, so no decoding or I/O takes place while the stream runs.
+     */
+    class MemorySource: public FrameSource
+    {
+        private:
+            // the frame data, when the source owns it
+            std::vector<uchar> owned;
+
+            // the first byte of the first frame
+            const uchar *data;
+
+            // the number of frames in the block
+            int n_frames;
+
+            // the size of each frame
+            cv::Size frame_size;
+
+            // the OpenCV type of each frame
+            int type;
+
+            // the rate to timestamp the frames at
+            double fps;
+
+            // the index of the next frame
+            int seq = 0;
+
+        public:
+            /**
+             * Constructor for a MemorySource over memory owned by the caller, which must
+             * outlive the source.
+             *
+             * @param d pointer to the first frame
+             * @param n the number of frames
+             * @param s the size of each frame
+             * @param t the OpenCV type of each frame
+             * @param f the frame rate to timestamp the frames at
+             */
+            MemorySource(const uchar *d, int n, cv::Size s, int t, double f);
+
+            /**
+             * Constructor for a MemorySource which takes ownership of the frame data.
+             *
+             * @param d the frame data
+             * @param s the size of each frame
+             * @param t the OpenCV type of each frame
+             * @param f the frame rate to timestamp the frames at
+             */
+            MemorySource(std::vector<uchar> &&d, cv::Size s, int t, double f);
+
+            bool isOpened() override;
+            cv::Size size() override;
+            bool read(cv::Mat &frame, double *timestamp_ms) override;
+    };
+
+    /**
+     * Delivers the frames of another source at their timestamps, or as fast as they
+     * can be read.
+     */
+    class ReplaySource: public FrameSource
+    {
+        private:
+            // the source being replayed, owned by the ReplaySource
+            FrameSource *inner;
+
+            // how the frames are paced
+            Replay mode;
+
+            // when the first frame was delivered
+            Clock::time_point start;
+
+            // has a frame been delivered yet
+            bool started = false;
+
+        public:
+            /**
+             * Primary constructor for the ReplaySource.
+             *
+             * @param s the source to replay, which the ReplaySource deletes
+             * @param m how to pace the frames
+             */
+            ReplaySource(FrameSource *s, Replay m);
+            ~ReplaySource();
+
+            ReplaySource(const ReplaySource&) = delete;
+            ReplaySource& operator=(const ReplaySource&) = delete;
+
+            bool isOpened() override;
+            cv::Size size() override;
+            bool read(cv::Mat &frame, double *timestamp_ms) override;
+    };
+
+    /**
+     * Opens a source from a command line spec:
+     *   camera[:index]                    a camera, device 0 by default
+     *   video:path                        a video file
+     *   images:dir[:fps]                  the images in a directory, 30 fps by default
+     *   raw:path:WIDTHxHEIGHT[:fps]       a file of back to back BGR frames, loaded into
+     *                                     memory up front, 30 fps by default
+     * Recorded sources are wrapped in a ReplaySource with the given mode.
+     *
+     * @param spec the source spec
+     * @param mode how to pace recorded sources
+     *
+     * @return the new source, which the caller deletes, or nullptr if the spec is
+     *         malformed
+     */
+    FrameSource* openSource(const std::string &spec, Replay mode);
+}
+
+#endif
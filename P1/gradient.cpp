@@ -0,0 +1,312 @@
+#include <math.h>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "gradient.h"
+#include "exec.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+#define SOBEL_FILTER_SIZE 3
+
+namespace gradient
+{
+    // horizontal responses of a pixel whose left or right neighbour is outside the row
+    static inline void horizontalEdge(const uchar *srow, short *hx, short *hy, int i, int n, int cn)
+    {
+        short left = i >= cn ? srow[i - cn] : 0;
+        short right = i < n - cn ? srow[i + cn] : 0;
+        hx[i] = right - left;
+        hy[i] = left + 2 * srow[i] + right;
+    }
+
+    // horizontal pass of both Sobel filters for one source row. SobelX uses
+    // [-1, 0, 1] and SobelY uses [1, 2, 1]; taps outside the row are skipped.
+    static inline void horizontalRowCn(const uchar *srow, short *hx, short *hy, int cols, int cn)
+    {
+        int n = cols * cn;
+        int interior_end = n - cn > cn ? n - cn : cn;
+
+        for (int i = 0; i < cn && i < n; i++)
+        {
+            horizontalEdge(srow, hx, hy, i, n, cn);
+        }
+
+        for (int i = cn; i < n - cn; i++)
+        {
+            hx[i] = srow[i + cn] - srow[i - cn];
+            hy[i] = srow[i - cn] + 2 * srow[i] + srow[i + cn];
+        }
+
+        for (int i = interior_end; i < n; i++)
+        {
+            horizontalEdge(srow, hx, hy, i, n, cn);
+        }
+    }
+
+    // the horizontal pass with the channel count known at compile time, so the
+    // neighbour offsets are constants and the interior loop vectorizes
+    template <int CN>
+    static void horizontalRowFixed(const uchar *srow, short *hx, short *hy, int cols)
+    {
+        int n = cols * CN;
+        int interior_end = n - CN > CN ? n - CN : CN;
+
+        for (int i = 0; i < CN && i < n; i++)
+        {
+            horizontalEdge(srow, hx, hy, i, n, CN);
+        }
+
+        for (int i = CN; i < n - CN; i++)
+        {
+            hx[i] = srow[i + CN] - srow[i - CN];
+            hy[i] = srow[i - CN] + 2 * srow[i] + srow[i + CN];
+        }
+
+        for (int i = interior_end; i < n; i++)
+        {
+            horizontalEdge(srow, hx, hy, i, n, CN);
+        }
+    }
+
+    // the horizontal pass, dispatched to the specialization for the channel count
+    static void horizontalRow(const uchar *srow, short *hx, short *hy, int cols, int cn)
+    {
+        switch (cn)
+        {
+            case 1:
+                horizontalRowFixed<1>(srow, hx, hy, cols);
+                break;
+            case 3:
+                horizontalRowFixed<3>(srow, hx, hy, cols);
+                break;
+            case 4:
+                horizontalRowFixed<4>(srow, hx, hy, cols);
+                break;
+            default:
+                horizontalRowCn(srow, hx, hy, cols, cn);
+                break;
+        }
+    }
+
+    // vertical pass of both Sobel filters. SobelX uses [1, 2, 1] and SobelY uses
+    // [1, 0, -1]; rows outside the image are passed in as rows of zeros.
+    static void verticalRow(
+        const short *ax, const short *cx, const short *bx,
+        const short *ay, const short *by,
+        short *sx, short *sy, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            sx[i] = (ax[i] + 2 * cx[i] + bx[i]) / 4;
+            sy[i] = (ay[i] - by[i]) / 4;
+        }
+    }
+
+    void magnitudeRow(const short *sx, const short *sy, uchar *mrow, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            // sqrtf is exact enough here never to round across an integer, and the
+            // narrowing through int keeps the wrap-around of magnitude() above 255
+            mrow[i] = (uchar) (int) sqrtf((float) (sx[i] * sx[i] + sy[i] * sy[i]));
+        }
+    }
+
+    void magnitudeRow(const float *sx, const float *sy, float *mrow, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            mrow[i] = sqrtf(sx[i] * sx[i] + sy[i] * sy[i]);
+        }
+    }
+
+    void angleRow(const short *sx, const short *sy, uchar *arow, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            arow[i] = (uchar) (cv::fastAtan2(sy[i], sx[i]) / 2);
+        }
+    }
+
+    int atan2Int(int y, int x)
+    {
+        int ax = abs(x);
+        int ay = abs(y);
+        if (ax == 0 && ay == 0)
+        {
+            return 0;
+        }
+
+        // atan(t) ~ t * pi / 4 + t * (1 - t) * (0.2447 + 0.0663 * t) for t = min / max
+        // in [0, 1], here with t in Q15 and the result in 65536ths of a turn, where
+        // an eighth of a turn is 8192 and 0.2447 and 0.0663 rad are 2552 and 692
+        int lo = ax < ay ? ax : ay;
+        int hi = ax < ay ? ay : ax;
+        int t = (lo << 15) / hi;
+        int curve = (((t * (32768 - t)) >> 15) * (2552 + ((692 * t) >> 15))) >> 15;
+        int octant = ((8192 * t) >> 15) + curve;
+
+        int angle = ax >= ay ? octant : 16384 - octant;
+        if (x < 0)
+        {
+            angle = 32768 - angle;
+        }
+        if (y < 0)
+        {
+            angle = 65536 - angle;
+        }
+
+        return angle & 0xFFFF;
+    }
+
+    // the output value of a pixel whose strongest channel gradient is (x, y)
+    static inline uchar directionBin(int x, int y, int mag, int bins)
+    {
+        if (mag == 0)
+        {
+            return 0;
+        }
+
+        int angle = atan2Int(y, x);
+        int bin = (((angle + 32768 / bins) & 0xFFFF) * bins) >> 16;
+        return (uchar) ((bin + 1) * (255 / bins));
+    }
+
+    void orientationRow(const short *sx, const short *sy, uchar *orow, int cols, int cn, int bins)
+    {
+        for (int c = 0; c < cols; c++)
+        {
+            const short *px = sx + c * cn;
+            const short *py = sy + c * cn;
+
+            // the channel with the strongest gradient decides the direction
+            int best = 0;
+            int best_mag = px[0] * px[0] + py[0] * py[0];
+            for (int k = 1; k < cn; k++)
+            {
+                int mag = px[k] * px[k] + py[k] * py[k];
+                if (mag > best_mag)
+                {
+                    best = k;
+                    best_mag = mag;
+                }
+            }
+
+            orow[c] = directionBin(px[best], py[best], best_mag, bins);
+        }
+    }
+
+    void orientationRowPlanar(const short **sx, const short **sy, uchar *orow, int cols, int cn, int bins)
+    {
+        for (int c = 0; c < cols; c++)
+        {
+            int best = 0;
+            int best_mag = sx[0][c] * sx[0][c] + sy[0][c] * sy[0][c];
+            for (int k = 1; k < cn; k++)
+            {
+                int mag = sx[k][c] * sx[k][c] + sy[k][c] * sy[k][c];
+                if (mag > best_mag)
+                {
+                    best = k;
+                    best_mag = mag;
+                }
+            }
+
+            orow[c] = directionBin(sx[best][c], sy[best][c], best_mag, bins);
+        }
+    }
+
+    GradientSweep::GradientSweep(cv::Mat &s, int row_begin):
+        src(s),
+        n(s.cols * s.channels()),
+        hx_ring(SOBEL_FILTER_SIZE, s.cols * s.channels(), CV_16SC1),
+        hy_ring(SOBEL_FILTER_SIZE, s.cols * s.channels(), CV_16SC1),
+        zeros(1, s.cols * s.channels(), CV_16SC1)
+    {
+        (*zeros).setTo(0);
+
+        // prime the ring with the halo row above the band and the band's first row
+        for (int r = std::max(0, row_begin - 1); r <= row_begin && r < src.rows; r++)
+        {
+            int slot = r % SOBEL_FILTER_SIZE;
+            horizontalRow(src.ptr<uchar>(r), (*hx_ring).ptr<short>(slot), (*hy_ring).ptr<short>(slot), src.cols, src.channels());
+        }
+    }
+
+    void GradientSweep::row(int r, short *sx, short *sy)
+    {
+        if (r + 1 < src.rows)
+        {
+            int next = (r + 1) % SOBEL_FILTER_SIZE;
+            horizontalRow(src.ptr<uchar>(r + 1), (*hx_ring).ptr<short>(next), (*hy_ring).ptr<short>(next), src.cols, src.channels());
+        }
+
+        const short *zero_row = (*zeros).ptr<short>(0);
+        const short *cx = (*hx_ring).ptr<short>(r % SOBEL_FILTER_SIZE);
+        const short *ax = r > 0 ? (*hx_ring).ptr<short>((r - 1) % SOBEL_FILTER_SIZE) : zero_row;
+        const short *ay = r > 0 ? (*hy_ring).ptr<short>((r - 1) % SOBEL_FILTER_SIZE) : zero_row;
+        const short *bx = r + 1 < src.rows ? (*hx_ring).ptr<short>((r + 1) % SOBEL_FILTER_SIZE) : zero_row;
+        const short *by = r + 1 < src.rows ? (*hy_ring).ptr<short>((r + 1) % SOBEL_FILTER_SIZE) : zero_row;
+
+        verticalRow(ax, cx, bx, ay, by, sx, sy, n);
+    }
+
+    int computeGradients(cv::Mat &src, GradientOutputs &out, int row_begin, int row_end)
+    {
+        if (src.empty() || src.depth() != CV_8U)
+        {
+            return ERROR_CODE;
+        }
+
+        int n = src.cols * src.channels();
+        GradientSweep sweep(src, row_begin);
+
+        // scratch rows for the responses the caller did not ask for
+        pool::PooledMat sx_scratch(1, n, CV_16SC1);
+        pool::PooledMat sy_scratch(1, n, CV_16SC1);
+
+        for (int r = row_begin; r < row_end; r++)
+        {
+            short *sx = out.sx ? out.sx->ptr<short>(r) : (*sx_scratch).ptr<short>(0);
+            short *sy = out.sy ? out.sy->ptr<short>(r) : (*sy_scratch).ptr<short>(0);
+            sweep.row(r, sx, sy);
+
+            if (out.mag)
+            {
+                magnitudeRow(sx, sy, out.mag->ptr<uchar>(r), n);
+            }
+            if (out.angle)
+            {
+                angleRow(sx, sy, out.angle->ptr<uchar>(r), n);
+            }
+        }
+
+        return SUCCESS_CODE;
+    }
+
+    int computeGradients(cv::Mat &src, GradientOutputs &out)
+    {
+        if (src.empty() || src.depth() != CV_8U)
+        {
+            return ERROR_CODE;
+        }
+
+        // a band would overwrite source rows the band above still reads, so an output
+        // sharing the source's data takes one sweep, which reads row r + 1 before it
+        // writes row r
+        cv::Mat *outputs[] = { out.sx, out.sy, out.mag, out.angle };
+        for (cv::Mat *o : outputs)
+        {
+            if (o && o->data == src.data)
+            {
+                return computeGradients(src, out, 0, src.rows);
+            }
+        }
+
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            computeGradients(src, out, row_begin, row_end);
+        });
+
+        return SUCCESS_CODE;
+    }
+}
@@ -0,0 +1,178 @@
+/**
+ * Header for the fused gradient engine. The engine makes a single pass over the
+ * source image, keeping the horizontal Sobel responses for the last three rows
+ * in small rolling line buffers, and writes any combination of the SobelX, SobelY,
+ * magnitude and orientation images from that one pass.
+ */
+
+#ifndef P1_GRADIENT
+#define P1_GRADIENT
+
+#include <opencv2/opencv.hpp>
+#include "bufferPool.h"
+
+namespace gradient
+{
+    /**
+     * The images the gradient engine should write. Any output left as a nullptr
+     * is skipped. Outputs which are set must already be allocated at the size of
+     * the source image, with its channel count cn.
+     */
+    struct GradientOutputs
+    {
+        // CV_16SC(cn) responses of the SobelX filter, as produced by sobelX3x3()
+        cv::Mat *sx = nullptr;
+
+        // CV_16SC(cn) responses of the SobelY filter, as produced by sobelY3x3()
+        cv::Mat *sy = nullptr;
+
+        // CV_8UC(cn) gradient magnitude, as produced by magnitude()
+        cv::Mat *mag = nullptr;
+
+        // CV_8UC(cn) gradient direction in degrees halved (0 - 179), the same
+        // convention OpenCV uses for 8-bit hue
+        cv::Mat *angle = nullptr;
+    };
+
+    /**
+     * A top-to-bottom sweep of both Sobel filters over an image. The horizontal
+     * responses of the last three rows are kept in rolling line buffers, so each call
+     * to row() runs the horizontal pass on one new source row only. Other kernels can
+     * pull rows from a sweep one at a time to fuse further work onto each row.
+     */
+    class GradientSweep
+    {
+        private:
+            // the source image
+            cv::Mat &src;
+
+            // the number of values in a row (cols * channels)
+            int n;
+
+            // rolling line buffers holding the horizontal responses of three rows
+            pool::PooledMat hx_ring;
+            pool::PooledMat hy_ring;
+
+            // a row of zeros standing in for the rows outside the image
+            pool::PooledMat zeros;
+
+        public:
+            /**
+             * Primary constructor for the GradientSweep. The line buffers are primed with
+             * the halo row above row_begin, so a band comes out exactly as it would from
+             * a sweep over the whole image.
+             *
+             * @param s reference to the uchar source image
+             * @param row_begin the first row the sweep will produce
+             */
+            GradientSweep(cv::Mat &s, int row_begin);
+
+            /**
+             * Produces the SobelX and SobelY responses of the next row. Rows must be
+             * requested in increasing order starting from row_begin.
+             *
+             * @param r the row
+             * @param sx pointer to the row of SobelX responses to fill
+             * @param sy pointer to the row of SobelY responses to fill
+             */
+            void row(int r, short *sx, short *sy);
+    };
+
+    /**
+     * Computes one row of gradient magnitude, as magnitude() does.
+     *
+     * @param sx pointer to the row of SobelX responses
+     * @param sy pointer to the row of SobelY responses
+     * @param mrow pointer to the magnitude row to fill
+     * @param n the number of values in the row
+     */
+    void magnitudeRow(const short *sx, const short *sy, uchar *mrow, int n);
+
+    /**
+     * Computes one row of gradient magnitude from float responses, as magnitude()
+     * does for CV_32F gradients.
+     *
+     * @param sx pointer to the row of SobelX responses
+     * @param sy pointer to the row of SobelY responses
+     * @param mrow pointer to the magnitude row to fill
+     * @param n the number of values in the row
+     */
+    void magnitudeRow(const float *sx, const float *sy, float *mrow, int n);
+
+    /**
+     * Computes one row of gradient direction, in degrees halved.
+     *
+     * @param sx pointer to the row of SobelX responses
+     * @param sy pointer to the row of SobelY responses
+     * @param arow pointer to the angle row to fill
+     * @param n the number of values in the row
+     */
+    void angleRow(const short *sx, const short *sy, uchar *arow, int n);
+
+    /**
+     * Integer approximation of atan2 with no trig calls. The angle is measured in
+     * 65536ths of a turn, counterclockwise from the positive x axis as fastAtan2()
+     * measures it, and is within about a tenth of a degree of the true angle.
+     *
+     * @param y the y component of the vector
+     * @param x the x component of the vector
+     *
+     * @return the angle of the vector in 0 - 65535, 0 for the zero vector
+     */
+    int atan2Int(int y, int x);
+
+    /**
+     * Computes one row of quantized gradient direction. Each pixel takes the direction
+     * of its strongest channel, quantized into bins centered on multiples of
+     * 360 / bins degrees, so bin 0 holds directions around 0 degrees. Bin b is written
+     * as (b + 1) * (255 / bins), leaving 0 for pixels with no gradient.
+     *
+     * @param sx pointer to the row of SobelX responses
+     * @param sy pointer to the row of SobelY responses
+     * @param orow pointer to the single channel orientation row to fill
+     * @param cols the number of pixels in the row
+     * @param cn the number of channels in the gradient rows
+     * @param bins the number of direction bins, 2 - 255
+     */
+    void orientationRow(const short *sx, const short *sy, uchar *orow, int cols, int cn, int bins);
+
+    /**
+     * Computes one row of quantized gradient direction, as orientationRow() does, from
+     * gradients held as one row per channel.
+     *
+     * @param sx array of pointers to the SobelX response row of each channel
+     * @param sy array of pointers to the SobelY response row of each channel
+     * @param orow pointer to the single channel orientation row to fill
+     * @param cols the number of pixels in the row
+     * @param cn the number of channels
+     * @param bins the number of direction bins, 2 - 255
+     */
+    void orientationRowPlanar(const short **sx, const short **sy, uchar *orow, int cols, int cn, int bins);
+
+    /**
+     * Computes the requested gradient images for the rows [row_begin, row_end) of the
+     * source image in a single sweep, exactly as they would come out of a sweep over
+     * the whole image.
+     *
+     * @param src reference to the uchar source image with 1, 3 or 4 channels
+     * @param out the set of images to write
+     * @param row_begin the first row to compute
+     * @param row_end one past the last row to compute
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int computeGradients(cv::Mat &src, GradientOutputs &out, int row_begin, int row_end);
+
+    /**
+     * Computes the requested gradient images of the source image in a single sweep,
+     * split into row bands on the exec thread pool.
+     *
+     * @param src reference to the uchar source image with 1, 3 or 4 channels
+     * @param out the set of images to write
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int computeGradients(cv::Mat &src, GradientOutputs &out);
+}
+
+#endif
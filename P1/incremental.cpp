@@ -0,0 +1,191 @@
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "incremental.h"
+#include "exec.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace incremental
+{
+    IncrementalFilter::IncrementalFilter(FilterFn f, int halo_px, int tile_px, int threshold_value):
+        filter(f),
+        halo(std::max(0, halo_px)),
+        tile(std::max(1, tile_px)),
+        threshold(std::max(0, threshold_value))
+    {}
+
+    // does any value of a row segment differ from the reference by more than threshold
+    static bool segmentChanged(const uchar *a, const uchar *b, int n, int threshold)
+    {
+        if (threshold == 0)
+        {
+            return memcmp(a, b, n) != 0;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (abs(a[i] - b[i]) > threshold)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int IncrementalFilter::diffTiles(cv::Mat &src, int tiles_x, int tiles_y)
+    {
+        size_t px_bytes = src.elemSize();
+        exec::forEachBand(tiles_y, [&](int ty_begin, int ty_end) {
+            for (int ty = ty_begin; ty < ty_end; ty++)
+            {
+                int row_end = std::min(src.rows, (ty + 1) * tile);
+                for (int tx = 0; tx < tiles_x; tx++)
+                {
+                    int col = tx * tile;
+                    int n = (int) ((std::min(src.cols, col + tile) - col) * px_bytes);
+                    bool diff = false;
+                    for (int r = ty * tile; r < row_end && !diff; r++)
+                    {
+                        diff = segmentChanged(src.ptr<uchar>(r) + col * px_bytes, reference.ptr<uchar>(r) + col * px_bytes, n, threshold);
+                    }
+                    dirty[ty * tiles_x + tx] = diff;
+                }
+            }
+        });
+
+        int count = 0;
+        for (size_t i = 0; i < dirty.size(); i++)
+        {
+            count += dirty[i];
+        }
+        return count;
+    }
+
+    int IncrementalFilter::recompute(cv::Mat &src, cv::Rect r)
+    {
+        // a changed pixel moves the output within the halo of it, and each of those
+        // output pixels reads the halo around it, all clipped to the frame. Pixels
+        // within the halo of a clipped edge are on the frame's own border, so they
+        // come out as they would from the whole frame.
+        cv::Rect bounds(0, 0, src.cols, src.rows);
+        cv::Rect moved = cv::Rect(r.x - halo, r.y - halo, r.width + 2 * halo, r.height + 2 * halo) & bounds;
+        cv::Rect region = cv::Rect(moved.x - halo, moved.y - halo, moved.width + 2 * halo, moved.height + 2 * halo) & bounds;
+
+        cv::Mat src_region = src(region);
+        if (filter(src_region, scratch) != SUCCESS_CODE || scratch.size() != region.size() || scratch.type() != out.type())
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat out_moved = out(moved);
+        scratch(cv::Rect(moved.x - region.x, moved.y - region.y, moved.width, moved.height)).copyTo(out_moved);
+        counters.recomputed_pixels += moved.area();
+
+        cv::Mat ref_region = reference(r);
+        src(r).copyTo(ref_region);
+
+        return SUCCESS_CODE;
+    }
+
+    int IncrementalFilter::apply(cv::Mat &src, cv::Mat &dst)
+    {
+        int result = applyTiles(src, dst);
+
+        std::unique_lock<std::mutex> lock(stats_mtx);
+        published = counters;
+        return result;
+    }
+
+    IncrementalStats IncrementalFilter::stats() const
+    {
+        std::unique_lock<std::mutex> lock(stats_mtx);
+        return published;
+    }
+
+    int IncrementalFilter::applyTiles(cv::Mat &src, cv::Mat &dst)
+    {
+        if (src.empty())
+        {
+            return ERROR_CODE;
+        }
+
+        int tiles_x = (src.cols + tile - 1) / tile;
+        int tiles_y = (src.rows + tile - 1) / tile;
+        int n_tiles = tiles_x * tiles_y;
+        counters.frames++;
+        counters.tiles += n_tiles;
+        counters.pixels += src.total();
+
+        if (reference.size() != src.size() || reference.type() != src.type() || out.empty())
+        {
+            if (filter(src, out) != SUCCESS_CODE || out.size() != src.size())
+            {
+                reset();
+                return ERROR_CODE;
+            }
+            src.copyTo(reference);
+            dirty.assign(n_tiles, 1);
+
+            counters.full_frames++;
+            counters.recomputed_tiles += n_tiles;
+            counters.recomputed_pixels += src.total();
+            counters.last_fraction = 1;
+            out.copyTo(dst);
+            return SUCCESS_CODE;
+        }
+
+        int changed = diffTiles(src, tiles_x, tiles_y);
+
+        // each run of changed tiles along a tile row is filtered as one rectangle, so
+        // the halo is read once per run rather than once per tile
+        for (int ty = 0; ty < tiles_y; ty++)
+        {
+            for (int tx = 0; tx < tiles_x; tx++)
+            {
+                if (!dirty[ty * tiles_x + tx])
+                {
+                    continue;
+                }
+
+                int run_end = tx;
+                while (run_end < tiles_x && dirty[ty * tiles_x + run_end])
+                {
+                    run_end++;
+                }
+
+                int x = tx * tile;
+                int y = ty * tile;
+                cv::Rect r(x, y, std::min(src.cols, run_end * tile) - x, std::min(src.rows, y + tile) - y);
+                if (recompute(src, r) != SUCCESS_CODE)
+                {
+                    reset();
+                    return ERROR_CODE;
+                }
+
+                tx = run_end;
+            }
+        }
+
+        counters.recomputed_tiles += changed;
+        counters.last_fraction = (double) changed / n_tiles;
+        out.copyTo(dst);
+
+        return SUCCESS_CODE;
+    }
+
+    void IncrementalFilter::setFilter(FilterFn f, int halo_px)
+    {
+        filter = f;
+        halo = std::max(0, halo_px);
+        reset();
+    }
+
+    void IncrementalFilter::reset()
+    {
+        reference.release();
+        out.release();
+    }
+}
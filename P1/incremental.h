@@ -0,0 +1,182 @@
+/**
+ * Header for incremental filtering of mostly static streams. Each frame is compared
+ * against the frame the current output was computed from, one square tile at a time,
+ * and the filter only runs again on the tiles which changed, widened by the reach of
+ * the filter's kernel. Every other pixel keeps its output from the frames before, so
+ * a fixed camera watching a still scene pays for the pixels that move rather than for
+ * the whole frame.
+ */
+
+#ifndef P1_INCREMENTAL
+#define P1_INCREMENTAL
+
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace incremental
+{
+    /**
+     * Applies a filter to a whole image. Returns 0 for success, -1 for failure.
+     */
+    typedef std::function<int(cv::Mat &src, cv::Mat &dst)> FilterFn;
+
+    /**
+     * Counters describing how much of each frame was recomputed.
+     */
+    struct IncrementalStats
+    {
+        // frames filtered
+        long frames = 0;
+
+        // frames filtered in full, the first of the stream and any after a reset or a
+        // change of size or type
+        long full_frames = 0;
+
+        // tiles in all frames filtered
+        long tiles = 0;
+
+        // tiles recomputed because their pixels changed, or every tile of a full frame
+        long recomputed_tiles = 0;
+
+        // pixels in all frames filtered
+        long pixels = 0;
+
+        // output pixels recomputed, the recomputed tiles widened by the halo
+        long recomputed_pixels = 0;
+
+        // the share of the tiles of the last frame which were recomputed, 0 - 1
+        double last_fraction = 0;
+
+        /**
+         * Getter for the share of all tiles which were recomputed.
+         *
+         * @return the fraction, 0 - 1
+         */
+        double fraction() const { return tiles > 0 ? (double) recomputed_tiles / tiles : 0; }
+    };
+
+    /**
+     * A filter applied incrementally to the frames of a stream.
+     */
+    class IncrementalFilter
+    {
+        private:
+            // the filter
+            FilterFn filter;
+
+            // how far the filter's kernel reaches from an output pixel, in pixels
+            int halo;
+
+            // the width and height of a tile
+            int tile;
+
+            // the largest difference of a pixel value still counted as unchanged
+            int threshold;
+
+            // the source the output was computed from, tile by tile
+            cv::Mat reference;
+
+            // the output, kept between frames
+            cv::Mat out;
+
+            // the filtered region of the last tile run, reused between runs
+            cv::Mat scratch;
+
+            // per tile, did its pixels change
+            std::vector<uchar> dirty;
+
+            // the counters, only touched by the thread calling apply()
+            IncrementalStats counters;
+
+            // a copy of the counters taken after each frame, for other threads to read
+            IncrementalStats published;
+
+            // guards published
+            mutable std::mutex stats_mtx;
+
+            /**
+             * Marks the tiles whose pixels differ from the reference.
+             *
+             * @param src reference to the new frame
+             * @param tiles_x the number of tile columns
+             * @param tiles_y the number of tile rows
+             *
+             * @return the number of changed tiles
+             */
+            int diffTiles(cv::Mat &src, int tiles_x, int tiles_y);
+
+            /**
+             * Filters again the output moved by a rectangle of changed pixels, which is
+             * the rectangle widened by the halo, and copies the rectangle of the frame
+             * into the reference.
+             *
+             * @param src reference to the new frame
+             * @param r the rectangle of changed tiles
+             *
+             * @return 0 for success, -1 for failure
+             */
+            int recompute(cv::Mat &src, cv::Rect r);
+
+            /**
+             * Filters the next frame of the stream, as apply() does, without publishing
+             * the counters.
+             *
+             * @param src reference to the frame
+             * @param dst reference to the destination image, allocated if needed
+             *
+             * @return 0 for success, -1 for failure
+             */
+            int applyTiles(cv::Mat &src, cv::Mat &dst);
+
+        public:
+            /**
+             * Primary constructor for the IncrementalFilter.
+             *
+             * @param f the filter, which must compute each output pixel from the source
+             *          pixels at most halo rows and cols away
+             * @param halo_px the reach of the filter's kernel, e.g. 2 for a 5x5 kernel
+             * @param tile_px the width and height of a tile
+             * @param threshold_value the largest per-value difference ignored when
+             *                        comparing frames. 0 makes the output identical to
+             *                        filtering every frame in full; above 0 a tile keeps
+             *                        its output until it drifts past the threshold.
+             */
+            IncrementalFilter(FilterFn f, int halo_px, int tile_px = 64, int threshold_value = 0);
+
+            /**
+             * Filters the next frame of the stream. Not thread safe: one thread at a time
+             * may filter through the same IncrementalFilter.
+             *
+             * @param src reference to the frame
+             * @param dst reference to the destination image, allocated if needed
+             *
+             * @return 0 for success, -1 for failure
+             */
+            int apply(cv::Mat &src, cv::Mat &dst);
+
+            /**
+             * Replaces the filter. The next frame is filtered in full; the counters are
+             * kept.
+             *
+             * @param f the new filter
+             * @param halo_px the reach of the new filter's kernel
+             */
+            void setFilter(FilterFn f, int halo_px);
+
+            /**
+             * Forgets the previous frame, so the next frame is filtered in full.
+             */
+            void reset();
+
+            /**
+             * Getter for the counters, safe to call from any thread.
+             *
+             * @return a copy of the counters as of the last frame filtered
+             */
+            IncrementalStats stats() const;
+    };
+}
+
+#endif
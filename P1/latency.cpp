@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "latency.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace latency
+{
+    int Histogram::bucketOf(long us)
+    {
+        // the top LATENCY_SUB_BITS + 1 bits of the time pick the bucket, so times
+        // below 2 * SUB_BUCKETS get a bucket each
+        int top_bit = 63 - __builtin_clzll((unsigned long long) us | 1);
+        int shift = std::max(0, top_bit - LATENCY_SUB_BITS);
+        int index = shift * SUB_BUCKETS + (int) (us >> shift);
+        return std::min(index, BUCKETS - 1);
+    }
+
+    long Histogram::bucketTop(int index)
+    {
+        if (index < 2 * SUB_BUCKETS)
+        {
+            return index;
+        }
+
+        int shift = index / SUB_BUCKETS - 1;
+        long top = index - shift * SUB_BUCKETS;
+        return ((top + 1) << shift) - 1;
+    }
+
+    void Histogram::record(long us)
+    {
+        us = std::max(us, 0L);
+        counts[bucketOf(us)]++;
+        total++;
+        sum_us += us;
+        max_us = std::max(max_us, us);
+    }
+
+    double Histogram::mean() const
+    {
+        return total > 0 ? (double) sum_us / total : 0;
+    }
+
+    long Histogram::percentile(double p) const
+    {
+        if (total == 0)
+        {
+            return 0;
+        }
+
+        // the rank of the percentile among the recorded times, counting from 1
+        long rank = std::max(1L, (long) (p / 100 * total + 0.5));
+        long seen = 0;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return std::min(bucketTop(i), max_us);
+            }
+        }
+
+        return max_us;
+    }
+
+    void Histogram::clear()
+    {
+        std::fill(counts, counts + BUCKETS, 0L);
+        total = 0;
+        sum_us = 0;
+        max_us = 0;
+    }
+
+    void LatencyRecorder::record(const std::string &name, long us)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        histograms[name].record(us);
+    }
+
+    std::vector<LatencySummary> LatencyRecorder::summaries()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        std::vector<LatencySummary> out;
+        for (auto it = histograms.begin(); it != histograms.end(); it++)
+        {
+            const Histogram &h = it->second;
+            LatencySummary s;
+            s.name = it->first;
+            s.count = h.count();
+            s.mean_ms = h.mean() / 1000;
+            s.p50_ms = h.percentile(50) / 1000.0;
+            s.p90_ms = h.percentile(90) / 1000.0;
+            s.p99_ms = h.percentile(99) / 1000.0;
+            s.max_ms = h.max() / 1000.0;
+            out.push_back(s);
+        }
+
+        return out;
+    }
+
+    // writes a string as a JSON string literal
+    static void writeJsonString(FILE *f, const std::string &s)
+    {
+        fputc('"', f);
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            unsigned char c = s[i];
+            if (c == '"' || c == '\\')
+            {
+                fprintf(f, "\\%c", c);
+            }
+            else if (c < 0x20)
+            {
+                fprintf(f, "\\u%04x", c);
+            }
+            else
+            {
+                fputc(c, f);
+            }
+        }
+        fputc('"', f);
+    }
+
+    int LatencyRecorder::writeJson(const std::string &path, const Labels &labels)
+    {
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return ERROR_CODE;
+        }
+
+        fprintf(f, "{\n");
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            fprintf(f, "  ");
+            writeJsonString(f, labels[i].first);
+            fprintf(f, ": ");
+            writeJsonString(f, labels[i].second);
+            fprintf(f, ",\n");
+        }
+
+        std::vector<LatencySummary> all = summaries();
+        fprintf(f, "  \"filters\": [");
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            const LatencySummary &s = all[i];
+            fprintf(f, "%s\n    {\"name\": ", i > 0 ? "," : "");
+            writeJsonString(f, s.name);
+            fprintf(
+                f, ", \"count\": %ld, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+                "\"p99_ms\": %.3f, \"max_ms\": %.3f}",
+                s.count, s.mean_ms, s.p50_ms, s.p90_ms, s.p99_ms, s.max_ms);
+        }
+        fprintf(f, "%s]\n}\n", all.empty() ? "" : "\n  ");
+
+        return fclose(f) == 0 ? SUCCESS_CODE : ERROR_CODE;
+    }
+
+    // writes a CSV field, quoted with any quote inside doubled when it holds a comma,
+    // a quote or a line break, as RFC 4180 describes
+    static void writeCsvField(FILE *f, const std::string &s)
+    {
+        if (s.find_first_of(",\"\r\n") == std::string::npos)
+        {
+            fputs(s.c_str(), f);
+            return;
+        }
+
+        fputc('"', f);
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            if (s[i] == '"')
+            {
+                fputc('"', f);
+            }
+            fputc(s[i], f);
+        }
+        fputc('"', f);
+    }
+
+    int LatencyRecorder::writeCsv(const std::string &path, const Labels &labels)
+    {
+        FILE *f = fopen(path.c_str(), "w");
+        if (!f)
+        {
+            return ERROR_CODE;
+        }
+
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            writeCsvField(f, labels[i].first);
+            fputc(',', f);
+        }
+        fprintf(f, "filter,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n");
+
+        std::vector<LatencySummary> all = summaries();
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            const LatencySummary &s = all[i];
+            for (size_t k = 0; k < labels.size(); k++)
+            {
+                writeCsvField(f, labels[k].second);
+                fputc(',', f);
+            }
+            writeCsvField(f, s.name);
+            fprintf(
+                f, ",%ld,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                s.count, s.mean_ms, s.p50_ms, s.p90_ms, s.p99_ms, s.max_ms);
+        }
+
+        return fclose(f) == 0 ? SUCCESS_CODE : ERROR_CODE;
+    }
+
+    int LatencyRecorder::write(const std::string &path, const Labels &labels)
+    {
+        const std::string ext = ".json";
+        if (path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0)
+        {
+            return writeJson(path, labels);
+        }
+
+        return writeCsv(path, labels);
+    }
+
+    void LatencyRecorder::clear()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        histograms.clear();
+    }
+
+    LatencyRecorder& filterLatency()
+    {
+        static LatencyRecorder filter_latency;
+        return filter_latency;
+    }
+
+    ScopedTimer::ScopedTimer(const char *n, LatencyRecorder &r):
+        recorder(r),
+        name(n),
+        start(std::chrono::steady_clock::now())
+    {}
+
+    ScopedTimer::~ScopedTimer()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        recorder.record(name, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+}
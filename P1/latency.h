@@ -0,0 +1,239 @@
+/**
+ * Header for the filter latency histograms. Each filter's run times go into a
+ * histogram with logarithmic buckets, each power of two split into 32 linear
+ * sub-buckets, so every recorded time is kept to within about 3% from microseconds
+ * to minutes in a fixed few kilobytes and recording never allocates. Percentiles are
+ * read off the buckets at any time, for the live overlay, and the histograms of every
+ * filter can be dumped to JSON or CSV.
+ */
+
+#ifndef P1_LATENCY
+#define P1_LATENCY
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// the number of linear sub-buckets in each power of two, as a power of two
+#define LATENCY_SUB_BITS 5
+
+// the largest power of two above the sub-bucket range a histogram covers, so
+// times up to 2^41 us (about 25 days) are recorded without clamping
+#define LATENCY_MAX_SHIFT 35
+
+namespace latency
+{
+    /**
+     * A histogram of times in microseconds.
+     */
+    class Histogram
+    {
+        private:
+            static constexpr int SUB_BUCKETS = 1 << LATENCY_SUB_BITS;
+            static constexpr int BUCKETS = (LATENCY_MAX_SHIFT + 2) * SUB_BUCKETS;
+
+            // the number of times recorded in each bucket
+            long counts[BUCKETS] = {};
+
+            // the number of times recorded
+            long total = 0;
+
+            // the sum and largest of the times recorded
+            long long sum_us = 0;
+            long max_us = 0;
+
+            /**
+             * Gets the bucket a time falls in.
+             *
+             * @param us the time in microseconds
+             *
+             * @return the bucket index
+             */
+            static int bucketOf(long us);
+
+            /**
+             * Gets the largest time a bucket holds.
+             *
+             * @param index the bucket index
+             *
+             * @return the time in microseconds
+             */
+            static long bucketTop(int index);
+
+        public:
+            /**
+             * Records a time.
+             *
+             * @param us the time in microseconds, negative times count as 0
+             */
+            void record(long us);
+
+            /**
+             * Getter for the number of times recorded.
+             *
+             * @return the count
+             */
+            long count() const { return total; }
+
+            /**
+             * Getter for the largest time recorded.
+             *
+             * @return the time in microseconds, exact
+             */
+            long max() const { return max_us; }
+
+            /**
+             * Getter for the mean of the times recorded.
+             *
+             * @return the mean in microseconds, 0 when empty
+             */
+            double mean() const;
+
+            /**
+             * Gets the time below which a given share of the recorded times fall.
+             *
+             * @param p the percentile, 0 - 100
+             *
+             * @return the largest time in the bucket holding the percentile, capped at
+             *         max(), in microseconds. 0 when empty.
+             */
+            long percentile(double p) const;
+
+            /**
+             * Empties the histogram.
+             */
+            void clear();
+    };
+
+    /**
+     * The percentiles of one filter's histogram, in milliseconds.
+     */
+    struct LatencySummary
+    {
+        // the filter name
+        std::string name;
+
+        // the number of runs recorded
+        long count = 0;
+
+        // the mean, the 50th, 90th and 99th percentiles and the largest run time
+        double mean_ms = 0;
+        double p50_ms = 0;
+        double p90_ms = 0;
+        double p99_ms = 0;
+        double max_ms = 0;
+    };
+
+    /**
+     * Name and value pairs describing a run, e.g. the source and resolution, written
+     * alongside the histograms so dumps from different configurations can be compared.
+     */
+    typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+    /**
+     * A thread-safe set of histograms, one per filter name.
+     */
+    class LatencyRecorder
+    {
+        private:
+            // the histogram of each filter, in name order
+            std::map<std::string, Histogram> histograms;
+
+            // guards the histograms
+            std::mutex mtx;
+
+        public:
+            /**
+             * Records one run of a filter.
+             *
+             * @param name the filter name
+             * @param us the run time in microseconds
+             */
+            void record(const std::string &name, long us);
+
+            /**
+             * Getter for the percentiles of every filter recorded so far.
+             *
+             * @return one summary per filter, in name order
+             */
+            std::vector<LatencySummary> summaries();
+
+            /**
+             * Writes every filter's percentiles to a JSON file as an object holding the
+             * labels and a "filters" array.
+             *
+             * @param path the file to write
+             * @param labels the labels of the run
+             *
+             * @return 0 for success, -1 if the file could not be written
+             */
+            int writeJson(const std::string &path, const Labels &labels);
+
+            /**
+             * Writes every filter's percentiles to a CSV file, one line per filter with
+             * the labels in the leading columns.
+             *
+             * @param path the file to write
+             * @param labels the labels of the run
+             *
+             * @return 0 for success, -1 if the file could not be written
+             */
+            int writeCsv(const std::string &path, const Labels &labels);
+
+            /**
+             * Writes to JSON if the path ends in ".json" and to CSV otherwise.
+             *
+             * @param path the file to write
+             * @param labels the labels of the run
+             *
+             * @return 0 for success, -1 if the file could not be written
+             */
+            int write(const std::string &path, const Labels &labels);
+
+            /**
+             * Empties every histogram.
+             */
+            void clear();
+    };
+
+    /**
+     * Getter for the recorder of the filters applied by VidDisplay.
+     *
+     * @return the shared recorder
+     */
+    LatencyRecorder& filterLatency();
+
+    /**
+     * Times a scope and records it on destruction.
+     */
+    class ScopedTimer
+    {
+        private:
+            // the recorder to record into
+            LatencyRecorder &recorder;
+
+            // the name to record under
+            const char *name;
+
+            // when the scope was entered
+            std::chrono::steady_clock::time_point start;
+
+        public:
+            /**
+             * Primary constructor for the ScopedTimer. Starts timing.
+             *
+             * @param n the name to record under, which must outlive the timer
+             * @param r the recorder to record into
+             */
+            ScopedTimer(const char *n, LatencyRecorder &r = filterLatency());
+            ~ScopedTimer();
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+}
+
+#endif
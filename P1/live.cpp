@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "live.h"
+#include "bufferPool.h"
+#include "latency.h"
+#include "pyramid.h"
+
+// how long a stage waits on an empty ring before checking whether to stop
+#define POP_TIMEOUT_MS 10
+
+// the window over which the display frame rate is averaged
+#define FPS_WINDOW_MS 1000
+
+namespace live
+{
+    FrameRing::FrameRing(int capacity, cv::Size size, int type, bool drop):
+        slots(capacity),
+        drop_oldest(drop)
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            slots[i].img.create(size, type);
+        }
+    }
+
+    void FrameRing::push(const cv::Mat &img, long seq, Clock::time_point captured)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            if (!drop_oldest)
+            {
+                space_cv.wait(lock, [&] { return count < (int) slots.size() || closed; });
+            }
+            if (closed)
+            {
+                return;
+            }
+            if (count == (int) slots.size())
+            {
+                // drop-oldest: the new frame takes the oldest frame's slot
+                head = (head + 1) % slots.size();
+                count--;
+                dropped++;
+            }
+
+            Frame &slot = slots[(head + count) % slots.size()];
+            img.copyTo(slot.img);
+            slot.seq = seq;
+            slot.captured = captured;
+            count++;
+        }
+        ready_cv.notify_one();
+    }
+
+    bool FrameRing::pop(Frame &out, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!ready_cv.wait_for(lock, timeout, [&] { return count > 0 || closed; }) || count == 0)
+        {
+            return false;
+        }
+
+        Frame &slot = slots[head];
+        cv::swap(slot.img, out.img);
+        out.seq = slot.seq;
+        out.captured = slot.captured;
+        head = (head + 1) % slots.size();
+        count--;
+        lock.unlock();
+        space_cv.notify_one();
+
+        return true;
+    }
+
+    void FrameRing::close()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            closed = true;
+        }
+        ready_cv.notify_all();
+        space_cv.notify_all();
+    }
+
+    bool FrameRing::finished()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return closed && count == 0;
+    }
+
+    long FrameRing::droppedFrames()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return dropped;
+    }
+
+    int FrameRing::depth()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return count;
+    }
+
+    LiveFilter::LiveFilter(source::FrameSource *s, FilterFn f, int capacity, int preview_level, bool drop):
+        src(s),
+        filter(f),
+        save_filter(f),
+        selected(' '),
+        running(true),
+        captured(capacity, s->size(), CV_8UC3, drop),
+        filtered(capacity, pyramid::levelSize(s->size(), preview_level), CV_8UC3, drop),
+        preview(preview_level),
+        // the frame on screen is at most the filtered ring plus the frame being
+        // filtered behind the newest frame kept
+        full_res(preview_level > 0 ? capacity + 2 : 0)
+    {}
+
+    void LiveFilter::captureLoop()
+    {
+        cv::Mat frame;
+        double timestamp_ms;
+        for (long seq = 0; running; seq++)
+        {
+            if (!src->read(frame, &timestamp_ms))
+            {
+                printf("Frame is empty\n");
+                break;
+            }
+
+            captured.push(frame, seq, Clock::now());
+        }
+
+        captured.close();
+    }
+
+    void LiveFilter::keepFullRes(Frame &frame)
+    {
+        std::unique_lock<std::mutex> lock(full_res_mtx);
+        Frame &slot = full_res[frame.seq % full_res.size()];
+        cv::swap(slot.img, frame.img);
+        slot.seq = frame.seq;
+        slot.captured = frame.captured;
+    }
+
+    void LiveFilter::saveFullRes(Frame &preview_frame, const std::function<bool(cv::Mat *)> &save)
+    {
+        cv::Mat full;
+        {
+            std::unique_lock<std::mutex> lock(full_res_mtx);
+            Frame &slot = full_res[preview_frame.seq % full_res.size()];
+            if (slot.seq == preview_frame.seq && !slot.img.empty())
+            {
+                slot.img.copyTo(full);
+            }
+        }
+        if (full.empty())
+        {
+            printf("Full resolution frame no longer available, saving the preview\n");
+            save(&preview_frame.img);
+            return;
+        }
+
+        cv::Mat out;
+        char key = selected;
+        if (key == ' ' || !save_filter(key, full, out))
+        {
+            save(&full);
+            return;
+        }
+        save(&out);
+    }
+
+    void LiveFilter::filterLoop()
+    {
+        Frame in;
+        cv::Mat out;
+        pyramid::Pyramid pyr;
+        while (running && !captured.finished())
+        {
+            if (!captured.pop(in, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+            {
+                continue;
+            }
+
+            // in preview mode the filter sees a pyramid level in place of the frame
+            cv::Mat *img = &in.img;
+            if (preview > 0)
+            {
+                pyr.reset(in.img);
+                img = &pyr.level(preview);
+            }
+
+            char key = selected;
+            cv::Mat *result = key == ' ' || !filter(key, *img, out) ? img : &out;
+            if (sink)
+            {
+                sink(*result);
+            }
+            filtered.push(*result, in.seq, in.captured);
+
+            if (preview > 0)
+            {
+                keepFullRes(in);
+            }
+        }
+
+        filtered.close();
+    }
+
+    void LiveFilter::drawOverlay(cv::Mat &img, double fps, double latency_ms)
+    {
+        char text[128];
+        snprintf(
+            text, sizeof(text), "%.1f fps  %.1f ms  dropped %ld/%ld",
+            fps, latency_ms, captured.droppedFrames(), filtered.droppedFrames());
+        if (preview > 0)
+        {
+            size_t len = strlen(text);
+            snprintf(text + len, sizeof(text) - len, "  preview 1/%d", 1 << preview);
+        }
+
+        // dark outline under the text keeps it readable on any filter output
+        cv::putText(img, text, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(0), 3);
+        cv::putText(img, text, cv::Point(10, 25), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(255), 1);
+
+        pool::PoolStats stats = pool::framePool().stats();
+        snprintf(text, sizeof(text), "buffer pool %ld hits  %ld misses", stats.hits, stats.misses);
+        cv::putText(img, text, cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(0), 3);
+        cv::putText(img, text, cv::Point(10, 50), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(255), 1);
+
+        int y = 75;
+        if (status)
+        {
+            std::string line = status();
+            cv::putText(img, line, cv::Point(10, y), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(0), 3);
+            cv::putText(img, line, cv::Point(10, y), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(255), 1);
+            y += 25;
+        }
+
+        if (!show_latency)
+        {
+            return;
+        }
+
+        std::vector<latency::LatencySummary> all = latency::filterLatency().summaries();
+        for (size_t i = 0; i < all.size(); i++, y += 25)
+        {
+            const latency::LatencySummary &s = all[i];
+            snprintf(
+                text, sizeof(text), "%-11s p50 %.1f  p90 %.1f  p99 %.1f  max %.1f ms",
+                s.name.c_str(), s.p50_ms, s.p90_ms, s.p99_ms, s.max_ms);
+            cv::putText(img, text, cv::Point(10, y), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(0), 3);
+            cv::putText(img, text, cv::Point(10, y), cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar::all(255), 1);
+        }
+    }
+
+    void LiveFilter::run(const std::function<bool(cv::Mat *)> &save)
+    {
+        std::thread capture_thread(&LiveFilter::captureLoop, this);
+        std::thread filter_thread(&LiveFilter::filterLoop, this);
+
+        Frame frame;
+        cv::Mat display;
+        std::deque<Clock::time_point> shown;
+        while (running && !filtered.finished())
+        {
+            if (filtered.pop(frame, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+            {
+                Clock::time_point now = Clock::now();
+                double latency_ms = std::chrono::duration<double, std::milli>(now - frame.captured).count();
+
+                // frames displayed within the last FPS window
+                shown.push_back(now);
+                while (now - shown.front() > std::chrono::milliseconds(FPS_WINDOW_MS))
+                {
+                    shown.pop_front();
+                }
+                double span = std::chrono::duration<double>(now - shown.front()).count();
+                double fps = span > 0 ? (shown.size() - 1) / span : 0;
+
+                // the overlay goes on a copy so saved frames stay clean
+                frame.img.copyTo(display);
+                drawOverlay(display, fps, latency_ms);
+                cv::imshow("Video", display);
+            }
+
+            int key = cv::waitKey(1);
+            if (key < 0)
+            {
+                continue;
+            }
+            if (key == 'q')
+            {
+                running = false;
+            }
+            else if (key == 'h')
+            {
+                show_latency = !show_latency;
+            }
+            else if (key == 's')
+            {
+                if (!frame.img.empty() && preview > 0)
+                {
+                    saveFullRes(frame, save);
+                }
+                else if (!frame.img.empty())
+                {
+                    save(&frame.img);
+                }
+            }
+            else
+            {
+                selected = (char) key;
+            }
+        }
+
+        running = false;
+        capture_thread.join();
+        filter_thread.join();
+    }
+
+    LiveStats LiveFilter::runHeadless(char key)
+    {
+        selected = key;
+        std::thread capture_thread(&LiveFilter::captureLoop, this);
+        std::thread filter_thread(&LiveFilter::filterLoop, this);
+
+        LiveStats stats;
+        Frame frame;
+        double total_latency_ms = 0;
+        Clock::time_point start = Clock::now();
+        while (!filtered.finished())
+        {
+            if (!filtered.pop(frame, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+            {
+                continue;
+            }
+
+            double latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - frame.captured).count();
+            total_latency_ms += latency_ms;
+            stats.max_latency_ms = std::max(stats.max_latency_ms, latency_ms);
+            stats.frames++;
+        }
+        stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        running = false;
+        capture_thread.join();
+        filter_thread.join();
+
+        stats.mean_latency_ms = stats.frames > 0 ? total_latency_ms / stats.frames : 0;
+        stats.captured_dropped = captured.droppedFrames();
+        stats.filtered_dropped = filtered.droppedFrames();
+
+        return stats;
+    }
+}
@@ -0,0 +1,326 @@
+/**
+ * Header for the live filter mode of VidDisplay. Capture, filtering and display run
+ * on separate threads connected by bounded rings of preallocated frames. A full ring
+ * drops its oldest frame, so a slow stage never stalls the stage feeding it and the
+ * display always shows the most recent frame available. Offline pipelines, which must
+ * not lose frames, use the same rings in blocking mode. For high resolution sources a
+ * preview mode filters and displays a level of the frame's pyramid instead, and only
+ * filters at full resolution when a frame is saved.
+ */
+
+#ifndef P1_LIVE
+#define P1_LIVE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "frameSource.h"
+
+namespace live
+{
+    typedef source::Clock Clock;
+
+    /**
+     * A frame travelling through the live pipeline.
+     */
+    struct Frame
+    {
+        // the image data
+        cv::Mat img;
+
+        // the index of the frame in the capture stream
+        long seq = 0;
+
+        // when the frame was captured, for measuring latency
+        Clock::time_point captured;
+    };
+
+    /**
+     * A bounded ring of frames shared by one producer and one consumer. The slots
+     * keep their image buffers between frames, so once every slot has seen a frame
+     * of the stream's size no further allocation takes place.
+     */
+    class FrameRing
+    {
+        private:
+            // the frame slots
+            std::vector<Frame> slots;
+
+            // index of the oldest frame in the ring
+            int head = 0;
+
+            // the number of frames in the ring
+            int count = 0;
+
+            // the number of frames overwritten before they were consumed
+            long dropped = 0;
+
+            // does a full ring drop its oldest frame rather than block the producer
+            bool drop_oldest;
+
+            // has the producer finished
+            bool closed = false;
+
+            // guards the ring state
+            std::mutex mtx;
+
+            // signalled when a frame is pushed or the ring is closed
+            std::condition_variable ready_cv;
+
+            // signalled when a frame is popped or the ring is closed
+            std::condition_variable space_cv;
+
+        public:
+            /**
+             * Primary constructor for the FrameRing.
+             *
+             * @param capacity the number of frame slots
+             * @param size the size of the frames, used to preallocate the slots
+             * @param type the type of the frames, used to preallocate the slots
+             * @param drop true to drop the oldest frame when full, false to block the
+             *             producer until a slot frees up
+             */
+            FrameRing(int capacity, cv::Size size, int type, bool drop = true);
+
+            /**
+             * Copies a frame into the ring. If the ring is full the oldest frame is
+             * dropped to make room, or in blocking mode the call waits for a free slot.
+             * Frames pushed after close() are discarded.
+             *
+             * @param img the image to copy in
+             * @param seq the index of the frame in the capture stream
+             * @param captured when the frame was captured
+             */
+            void push(const cv::Mat &img, long seq, Clock::time_point captured);
+
+            /**
+             * Takes the oldest frame out of the ring. The frame's image buffer is swapped
+             * with the one passed in, which the ring then reuses.
+             *
+             * @param out the frame to fill
+             * @param timeout how long to wait for a frame
+             *
+             * @return true if a frame was taken, false on timeout or once the ring is
+             *         closed and empty
+             */
+            bool pop(Frame &out, std::chrono::milliseconds timeout);
+
+            /**
+             * Marks the ring closed and wakes any waiting consumer.
+             */
+            void close();
+
+            /**
+             * Getter for whether the ring is closed and empty.
+             *
+             * @return true once no more frames will come out of the ring
+             */
+            bool finished();
+
+            /**
+             * Getter for the number of dropped frames.
+             *
+             * @return the number of frames overwritten before they were consumed
+             */
+            long droppedFrames();
+
+            /**
+             * Getter for the number of frames waiting in the ring.
+             *
+             * @return the ring depth
+             */
+            int depth();
+    };
+
+    /**
+     * Summary of a headless live run.
+     */
+    struct LiveStats
+    {
+        // frames which made it through the pipeline
+        long frames = 0;
+
+        // wall time of the run
+        double seconds = 0;
+
+        // mean and worst time from capture to the end of the pipeline
+        double mean_latency_ms = 0;
+        double max_latency_ms = 0;
+
+        // frames dropped by the capture and filtered rings
+        long captured_dropped = 0;
+        long filtered_dropped = 0;
+    };
+
+    /**
+     * Applies a filter to a frame. Returns false if the filter key is unknown.
+     */
+    typedef std::function<bool(char key, cv::Mat &src, cv::Mat &dst)> FilterFn;
+
+    /**
+     * Describes the state of the filter in one line, for the overlay.
+     */
+    typedef std::function<std::string()> StatusFn;
+
+    /**
+     * Receives each filtered frame on the filter thread, e.g. to record it.
+     */
+    typedef std::function<void(const cv::Mat &img)> SinkFn;
+
+    /**
+     * Runs the live filter loop. Capture and filtering each get a thread, and display
+     * and keyboard handling stay on the calling thread, as highgui requires.
+     */
+    class LiveFilter
+    {
+        private:
+            // the source to capture from
+            source::FrameSource *src;
+
+            // applies the selected filter, only ever called on the filter thread
+            FilterFn filter;
+
+            // applies the selected filter to full resolution frames saved on the
+            // display thread, while the filter thread may be running filter
+            FilterFn save_filter;
+
+            // the key of the selected filter, or ' ' for the raw stream
+            std::atomic<char> selected;
+
+            // cleared to stop every stage
+            std::atomic<bool> running;
+
+            // captured frames waiting to be filtered
+            FrameRing captured;
+
+            // filtered frames waiting to be displayed
+            FrameRing filtered;
+
+            // the pyramid level filtered for display, 0 for full resolution
+            int preview;
+
+            // in preview mode, the latest full resolution frames, each in slot
+            // seq % size, so a saved frame can be filtered again at full resolution
+            std::vector<Frame> full_res;
+
+            // guards full_res
+            std::mutex full_res_mtx;
+
+            // is the table of filter latencies drawn over the frame
+            bool show_latency = false;
+
+            // an extra line for the overlay, empty for none
+            StatusFn status;
+
+            // receives each filtered frame, empty for none
+            SinkFn sink;
+
+            /**
+             * Main loop of the capture thread.
+             */
+            void captureLoop();
+
+            /**
+             * Main loop of the filter thread.
+             */
+            void filterLoop();
+
+            /**
+             * Draws the frame rate and latency over a frame, and the latency
+             * percentiles of each filter when toggled on.
+             *
+             * @param img the frame to draw on
+             * @param fps the current display frame rate
+             * @param latency_ms the time from capture to display of this frame
+             */
+            void drawOverlay(cv::Mat &img, double fps, double latency_ms);
+
+            /**
+             * Keeps a full resolution frame for saving, by swapping its buffer with the
+             * oldest one kept.
+             *
+             * @param frame the frame which has just been filtered for preview
+             */
+            void keepFullRes(Frame &frame);
+
+            /**
+             * Filters a displayed preview frame again at full resolution and saves it.
+             * Falls back to saving the preview if the full resolution frame is gone.
+             *
+             * @param preview_frame the frame on screen
+             * @param save function saving a frame
+             */
+            void saveFullRes(Frame &preview_frame, const std::function<bool(cv::Mat *)> &save);
+
+        public:
+            /**
+             * Primary constructor for the LiveFilter.
+             *
+             * @param s the opened source to capture from
+             * @param f the function applying a filter by key
+             * @param capacity the number of frames each ring holds
+             * @param preview_level the pyramid level to filter and display, 0 for full
+             *                      resolution
+             * @param drop true for rings which drop their oldest frame when full, false
+             *             for rings which make the stage before them wait
+             */
+            LiveFilter(source::FrameSource *s, FilterFn f, int capacity, int preview_level = 0, bool drop = true);
+
+            /**
+             * Setter for an extra line drawn in the overlay, read on the display thread
+             * for each frame shown.
+             *
+             * @param s function describing the state of the filter
+             */
+            void setStatus(StatusFn s) { status = s; }
+
+            /**
+             * Setter for a function receiving each filtered frame, called on the filter
+             * thread before the frame goes on to display. It must return quickly, or it
+             * slows the filter thread down.
+             *
+             * @param s function receiving each filtered frame, at the preview level in
+             *          preview mode
+             */
+            void setSink(SinkFn s) { sink = s; }
+
+            /**
+             * Setter for the filter applied to full resolution frames saved in preview
+             * mode. It runs on the display thread at the same time as the live filter
+             * runs on the filter thread, so it must not share any state with it. The
+             * live filter is used until one is set, which is only safe if it keeps no
+             * state between calls.
+             *
+             * @param f the function applying a filter by key
+             */
+            void setSaveFilter(FilterFn f) { save_filter = f; }
+
+            /**
+             * Runs the live loop until 'q' is pressed or the source stops delivering
+             * frames. Filter keys switch the filter, space returns to the raw stream,
+             * 'h' toggles the filter latency table and 's' saves the frame on screen,
+             * at full resolution in preview mode.
+             *
+             * @param save function saving the frame on screen
+             */
+            void run(const std::function<bool(cv::Mat *)> &save);
+
+            /**
+             * Runs the live loop without a window until the source stops delivering
+             * frames, consuming filtered frames as fast as they arrive. Used to load
+             * test the pipeline from a recorded source.
+             *
+             * @param key the key of the filter to apply, or ' ' for none
+             *
+             * @return the throughput, latency and drop counts of the run
+             */
+            LiveStats runHeadless(char key);
+    };
+}
+
+#endif
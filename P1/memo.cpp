@@ -0,0 +1,237 @@
+#include <opencv2/opencv.hpp>
+#include "memo.h"
+#include "filters.h"
+#include "gradient.h"
+#include "bilateral.h"
+#include "pointOp.h"
+#include "exec.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace memo
+{
+    FrameCache::FrameCache():
+        frame_id(-1)
+    {}
+
+    bool FrameCache::setFrame(long id)
+    {
+        if (id == frame_id)
+        {
+            return false;
+        }
+
+        // an operation the last frame used is likely to be used again, so its buffer
+        // is kept for the new frame to compute into
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (it->second.valid)
+            {
+                it->second.valid = false;
+                ++it;
+            }
+            else
+            {
+                it = entries.erase(it);
+            }
+        }
+
+        frame_id = id;
+        counters.frames++;
+        return true;
+    }
+
+    cv::Mat* FrameCache::get(const std::string &op, const FillFn &fill)
+    {
+        Entry &entry = entries[op];
+        if (entry.valid)
+        {
+            counters.hits++;
+            return &entry.img;
+        }
+
+        counters.misses++;
+        if (fill(entry.img) != SUCCESS_CODE)
+        {
+            return nullptr;
+        }
+        entry.valid = true;
+        return &entry.img;
+    }
+
+    cv::Mat& FrameCache::buffer(const std::string &op)
+    {
+        return entries[op].img;
+    }
+
+    void FrameCache::validate(const std::string &op)
+    {
+        entries[op].valid = true;
+    }
+
+    void FrameCache::clear()
+    {
+        entries.clear();
+        frame_id = -1;
+    }
+
+    // can the gradient and cartoon kernels take the image
+    static bool supported(cv::Mat &src)
+    {
+        int cn = src.channels();
+        return src.depth() == CV_8U && (cn == 1 || cn == 3 || cn == 4);
+    }
+
+    cv::Mat* blurred(FrameCache &cache, cv::Mat &src)
+    {
+        return cache.get("blur", [&](cv::Mat &out) { return blur5x5(src, out); });
+    }
+
+    // fills the SobelX, SobelY and magnitude entries in one sweep of the gradient
+    // engine, since the magnitude costs little once the responses are computed
+    static int fillGradients(FrameCache &cache, cv::Mat &src)
+    {
+        if (!supported(src))
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat &sx = cache.buffer("sobelx");
+        cv::Mat &sy = cache.buffer("sobely");
+        cv::Mat &mag = cache.buffer("magnitude");
+        sx.create(src.rows, src.cols, CV_16SC(src.channels()));
+        sy.create(src.rows, src.cols, CV_16SC(src.channels()));
+        mag.create(src.rows, src.cols, src.type());
+
+        gradient::GradientOutputs out;
+        out.sx = &sx;
+        out.sy = &sy;
+        out.mag = &mag;
+        if (gradient::computeGradients(src, out) != SUCCESS_CODE)
+        {
+            return ERROR_CODE;
+        }
+
+        cache.validate("sobelx");
+        cache.validate("sobely");
+        cache.validate("magnitude");
+        return SUCCESS_CODE;
+    }
+
+    cv::Mat* sobelX(FrameCache &cache, cv::Mat &src)
+    {
+        return cache.get("sobelx", [&](cv::Mat &) { return fillGradients(cache, src); });
+    }
+
+    cv::Mat* sobelY(FrameCache &cache, cv::Mat &src)
+    {
+        return cache.get("sobely", [&](cv::Mat &) { return fillGradients(cache, src); });
+    }
+
+    cv::Mat* magnitude(FrameCache &cache, cv::Mat &src)
+    {
+        return cache.get("magnitude", [&](cv::Mat &) { return fillGradients(cache, src); });
+    }
+
+    cv::Mat* smoothed(FrameCache &cache, cv::Mat &src, int sigma_space, int sigma_range)
+    {
+        std::string op = "bilateral:" + std::to_string(sigma_space) + ":" + std::to_string(sigma_range);
+        return cache.get(op, [&](cv::Mat &out) {
+            out.create(src.rows, src.cols, src.type());
+            return bilateral::bilateralGrid(src, out, sigma_space, sigma_range);
+        });
+    }
+
+    int blurQuantize(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels)
+    {
+        if (levels < 1 || levels > 255)
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat *blur = blurred(cache, src);
+        if (!blur || blur->depth() != CV_8U)
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows, src.cols, src.type());
+        return pointop::quantizeOp(levels).apply(*blur, dst);
+    }
+
+    // quantizes the smoothed image and draws black where the magnitude is above the
+    // threshold, as the fused cartoon kernels do row by row
+    static int quantizeAndMask(cv::Mat &smooth, cv::Mat &mag, cv::Mat &dst, int levels, int magThreshold)
+    {
+        pointop::PointOp quantize = pointop::quantizeOp(levels);
+        int n = smooth.cols * smooth.channels();
+        dst.create(smooth.rows, smooth.cols, smooth.type());
+        exec::forEachBand(smooth.rows, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                pointop::lutMaskRow(
+                    quantize.lut(), smooth.ptr<uchar>(r), mag.ptr<uchar>(r), dst.ptr<uchar>(r), n, magThreshold);
+            }
+        });
+        return SUCCESS_CODE;
+    }
+
+    int cartoon(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels, int magThreshold)
+    {
+        if (levels < 1 || levels > 255 || !supported(src))
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat *blur = blurred(cache, src);
+        cv::Mat *mag = magnitude(cache, src);
+        if (!blur || !mag)
+        {
+            return ERROR_CODE;
+        }
+        return quantizeAndMask(*blur, *mag, dst, levels, magThreshold);
+    }
+
+    int cartoonBilateral(
+        FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels, int magThreshold, int sigma_space, int sigma_range)
+    {
+        if (levels < 1 || levels > 255 || !supported(src))
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat *smooth = smoothed(cache, src, sigma_space, sigma_range);
+        cv::Mat *mag = magnitude(cache, src);
+        if (!smooth || !mag)
+        {
+            return ERROR_CODE;
+        }
+        return quantizeAndMask(*smooth, *mag, dst, levels, magThreshold);
+    }
+
+    int orientation(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int bins)
+    {
+        if (bins < 2 || bins > 255)
+        {
+            return ERROR_CODE;
+        }
+
+        cv::Mat *sx = sobelX(cache, src);
+        cv::Mat *sy = sobelY(cache, src);
+        if (!sx || !sy)
+        {
+            return ERROR_CODE;
+        }
+
+        int cn = src.channels();
+        dst.create(src.rows, src.cols, CV_8UC1);
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                gradient::orientationRow(sx->ptr<short>(r), sy->ptr<short>(r), dst.ptr<uchar>(r), src.cols, cn, bins);
+            }
+        });
+        return SUCCESS_CODE;
+    }
+}
@@ -0,0 +1,252 @@
+/**
+ * Header for caching the intermediates of one frame. Cartoon, magnitude, orientation
+ * and the Sobel filters all start from the same blur and the same gradients, so when
+ * the frame stays put while the user switches filters or tweaks a filter's parameters,
+ * the cache computes each intermediate once and every later filter of that frame reads
+ * it back. Entries are keyed by the frame's id and the name of the operation, and are
+ * invalidated when a frame with a new id arrives.
+ */
+
+#ifndef P1_MEMO
+#define P1_MEMO
+
+#include <functional>
+#include <map>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+namespace memo
+{
+    /**
+     * Computes an intermediate into out, allocating it as needed. Returns 0 for
+     * success, -1 for failure.
+     */
+    typedef std::function<int(cv::Mat &out)> FillFn;
+
+    /**
+     * Counters describing how often the cache was reused.
+     */
+    struct CacheStats
+    {
+        // requests served by an entry of the current frame
+        long hits = 0;
+
+        // requests which had to compute their entry
+        long misses = 0;
+
+        // frames the cache has held
+        long frames = 0;
+    };
+
+    /**
+     * The intermediates of one frame, keyed by operation. Not thread safe; the cache
+     * belongs to the thread showing the frame.
+     */
+    class FrameCache
+    {
+        private:
+            /**
+             * One intermediate of the current frame.
+             */
+            struct Entry
+            {
+                // the intermediate, kept allocated across frames so the next frame
+                // computes into the same buffer
+                cv::Mat img;
+
+                // does img hold the operation's result for the current frame
+                bool valid = false;
+            };
+
+            // the id of the current frame, -1 before the first
+            long frame_id;
+
+            // the intermediates, keyed by operation
+            std::map<std::string, Entry> entries;
+
+            // hit and miss counts
+            CacheStats counters;
+
+        public:
+            /**
+             * Primary constructor for the FrameCache. The cache starts with no frame.
+             */
+            FrameCache();
+
+            /**
+             * Makes a frame the current one. A new id invalidates every entry, and the
+             * buffers of operations the last frame did not use are released.
+             *
+             * @param id the id of the frame, which must change whenever the frame does
+             *
+             * @return true if the id was new and the entries were invalidated
+             */
+            bool setFrame(long id);
+
+            /**
+             * Getter for the current frame.
+             *
+             * @return the id of the current frame, -1 before the first
+             */
+            long frame() const { return frame_id; }
+
+            /**
+             * Gets an intermediate of the current frame, computing it on a miss.
+             *
+             * @param op the name of the operation, including any parameters its
+             *           result depends on
+             * @param fill computes the intermediate into the entry's buffer
+             *
+             * @return pointer to the intermediate, valid until the next setFrame() or
+             *         clear(), or nullptr if fill failed
+             */
+            cv::Mat* get(const std::string &op, const FillFn &fill);
+
+            /**
+             * Gets the buffer of an entry without computing it, for operations which
+             * fill several entries in one pass. Call validate() once it is filled.
+             *
+             * @param op the name of the operation
+             *
+             * @return reference to the entry's buffer
+             */
+            cv::Mat& buffer(const std::string &op);
+
+            /**
+             * Marks an entry filled through buffer() as holding its result for the
+             * current frame.
+             *
+             * @param op the name of the operation
+             */
+            void validate(const std::string &op);
+
+            /**
+             * Releases every entry and forgets the current frame.
+             */
+            void clear();
+
+            /**
+             * Getter for the counters.
+             *
+             * @return the counters so far
+             */
+            CacheStats stats() const { return counters; }
+    };
+
+    /**
+     * Gets the 5x5 blur of a frame, as blur5x5() computes it.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the frame
+     *
+     * @return pointer to the cached blur, nullptr for failure
+     */
+    cv::Mat* blurred(FrameCache &cache, cv::Mat &src);
+
+    /**
+     * Gets the SobelX responses of a frame, as sobelX3x3() computes them. The SobelY
+     * responses and the magnitude are cached by the same sweep.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     *
+     * @return pointer to the cached short responses, nullptr for failure
+     */
+    cv::Mat* sobelX(FrameCache &cache, cv::Mat &src);
+
+    /**
+     * Gets the SobelY responses of a frame, as sobelY3x3() computes them. The SobelX
+     * responses and the magnitude are cached by the same sweep.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     *
+     * @return pointer to the cached short responses, nullptr for failure
+     */
+    cv::Mat* sobelY(FrameCache &cache, cv::Mat &src);
+
+    /**
+     * Gets the gradient magnitude of a frame, as magnitudeFilter() computes it. The
+     * Sobel responses are cached by the same sweep.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     *
+     * @return pointer to the cached uchar magnitude, nullptr for failure
+     */
+    cv::Mat* magnitude(FrameCache &cache, cv::Mat &src);
+
+    /**
+     * Gets the bilateral grid smoothing of a frame, as cartoonBilateral() smooths it.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     * @param sigma_space the width of a grid cell in pixels, 2 - 256
+     * @param sigma_range the height of a grid cell in luma levels, 1 - 128
+     *
+     * @return pointer to the cached smoothing, nullptr for failure
+     */
+    cv::Mat* smoothed(FrameCache &cache, cv::Mat &src, int sigma_space, int sigma_range);
+
+    /**
+     * Blurs and quantizes a frame from its cached blur, giving the image blurQuantize()
+     * does.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the frame
+     * @param dst reference to the destination image, allocated if needed
+     * @param levels the number of levels, 1 - 255
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int blurQuantize(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels);
+
+    /**
+     * Draws a frame as a cartoon from its cached blur and magnitude, giving the image
+     * cartoon() does. Only the quantization and the edge mask run again when levels
+     * or magThreshold change.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     * @param dst reference to the destination image, allocated if needed. Must not be
+     *            src.
+     * @param levels the number of levels, 1 - 255
+     * @param magThreshold pixels whose magnitude is above this are drawn black
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int cartoon(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels, int magThreshold);
+
+    /**
+     * Draws a frame as a bilateral cartoon from its cached smoothing and magnitude,
+     * giving the image cartoonBilateral() does.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     * @param dst reference to the destination image, allocated if needed. Must not be
+     *            src.
+     * @param levels the number of levels, 1 - 255
+     * @param magThreshold pixels whose magnitude is above this are drawn black
+     * @param sigma_space the width of a grid cell in pixels, 2 - 256
+     * @param sigma_range the height of a grid cell in luma levels, 1 - 128
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int cartoonBilateral(
+        FrameCache &cache, cv::Mat &src, cv::Mat &dst, int levels, int magThreshold, int sigma_space, int sigma_range);
+
+    /**
+     * Computes the orientation map of a frame from its cached Sobel responses, giving
+     * the image orientation() does.
+     *
+     * @param cache reference to the cache of the frame
+     * @param src reference to the uchar frame with 1, 3 or 4 channels
+     * @param dst reference to the CV_8UC1 destination image, allocated if needed
+     * @param bins the number of direction bins, 2 - 255
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int orientation(FrameCache &cache, cv::Mat &src, cv::Mat &dst, int bins);
+}
+
+#endif
@@ -0,0 +1,310 @@
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "planar.h"
+#include "filters.h"
+#include "gradient.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+// 8-bit BGR2GRAY weights of cvtColor, in 14-bit fixed point
+#define GRAY_SHIFT 14
+#define GRAY_B 1868
+#define GRAY_G 9617
+#define GRAY_R 4899
+
+namespace planar
+{
+    void Planes::create(int rows, int cols, int depth, int cn)
+    {
+        planes.resize(cn);
+        for (int k = 0; k < cn; k++)
+        {
+            planes[k].create(rows, cols, CV_MAKETYPE(depth, 1));
+        }
+    }
+
+    // copies one interleaved row out to one row of each plane
+    template <typename T>
+    static void splitRow(const T *src, T **dst, int cols, int cn)
+    {
+        if (cn == 3)
+        {
+            T *p0 = dst[0];
+            T *p1 = dst[1];
+            T *p2 = dst[2];
+            for (int c = 0; c < cols; c++)
+            {
+                p0[c] = src[c * 3 + 0];
+                p1[c] = src[c * 3 + 1];
+                p2[c] = src[c * 3 + 2];
+            }
+            return;
+        }
+
+        for (int c = 0; c < cols; c++)
+        {
+            for (int k = 0; k < cn; k++)
+            {
+                dst[k][c] = src[c * cn + k];
+            }
+        }
+    }
+
+    // copies one row of each plane into one interleaved row
+    template <typename T>
+    static void mergeRow(T **src, T *dst, int cols, int cn)
+    {
+        if (cn == 3)
+        {
+            const T *p0 = src[0];
+            const T *p1 = src[1];
+            const T *p2 = src[2];
+            for (int c = 0; c < cols; c++)
+            {
+                dst[c * 3 + 0] = p0[c];
+                dst[c * 3 + 1] = p1[c];
+                dst[c * 3 + 2] = p2[c];
+            }
+            return;
+        }
+
+        for (int c = 0; c < cols; c++)
+        {
+            for (int k = 0; k < cn; k++)
+            {
+                dst[c * cn + k] = src[k][c];
+            }
+        }
+    }
+
+    template <typename T>
+    static void splitRows(cv::Mat &src, Planes &dst)
+    {
+        int cn = src.channels();
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            std::vector<T *> rows(cn);
+            for (int r = row_begin; r < row_end; r++)
+            {
+                for (int k = 0; k < cn; k++)
+                {
+                    rows[k] = dst.plane(k).ptr<T>(r);
+                }
+                splitRow(src.ptr<T>(r), rows.data(), src.cols, cn);
+            }
+        });
+    }
+
+    template <typename T>
+    static void mergeRows(Planes &src, cv::Mat &dst)
+    {
+        int cn = src.channels();
+        exec::forEachBand(dst.rows, [&](int row_begin, int row_end) {
+            std::vector<T *> rows(cn);
+            for (int r = row_begin; r < row_end; r++)
+            {
+                for (int k = 0; k < cn; k++)
+                {
+                    rows[k] = src.plane(k).ptr<T>(r);
+                }
+                mergeRow(rows.data(), dst.ptr<T>(r), dst.cols, cn);
+            }
+        });
+    }
+
+    int split(cv::Mat &src, Planes &dst)
+    {
+        if (src.empty() || (src.depth() != CV_8U && src.depth() != CV_16S))
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows, src.cols, src.depth(), src.channels());
+        if (src.depth() == CV_8U)
+        {
+            splitRows<uchar>(src, dst);
+        }
+        else
+        {
+            splitRows<short>(src, dst);
+        }
+
+        return SUCCESS_CODE;
+    }
+
+    int merge(Planes &src, cv::Mat &dst)
+    {
+        if (src.channels() == 0 || (src.depth() != CV_8U && src.depth() != CV_16S))
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows(), src.cols(), CV_MAKETYPE(src.depth(), src.channels()));
+        if (src.depth() == CV_8U)
+        {
+            mergeRows<uchar>(src, dst);
+        }
+        else
+        {
+            mergeRows<short>(src, dst);
+        }
+
+        return SUCCESS_CODE;
+    }
+
+    int grayscale(Planes &src, cv::Mat &dst)
+    {
+        if (src.channels() != 3 || src.depth() != CV_8U)
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows(), src.cols(), CV_8UC1);
+        exec::forEachBand(src.rows(), [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                const uchar *b = src.plane(0).ptr<uchar>(r);
+                const uchar *g = src.plane(1).ptr<uchar>(r);
+                const uchar *red = src.plane(2).ptr<uchar>(r);
+                uchar *drow = dst.ptr<uchar>(r);
+                for (int c = 0; c < dst.cols; c++)
+                {
+                    int y = b[c] * GRAY_B + g[c] * GRAY_G + red[c] * GRAY_R;
+                    drow[c] = (uchar) ((y + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+                }
+            }
+        });
+
+        return SUCCESS_CODE;
+    }
+
+    // allocates dst like src at the given depth and runs fn on each pair of planes,
+    // returning the first failure
+    template <typename F>
+    static int eachPlane(Planes &src, Planes &dst, int depth, F fn)
+    {
+        if (src.channels() == 0)
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows(), src.cols(), depth, src.channels());
+        for (int k = 0; k < src.channels(); k++)
+        {
+            if (fn(src.plane(k), dst.plane(k)) != SUCCESS_CODE)
+            {
+                return ERROR_CODE;
+            }
+        }
+
+        return SUCCESS_CODE;
+    }
+
+    int blur5x5(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_8U, [](cv::Mat &s, cv::Mat &d) { return ::blur5x5(s, d); });
+    }
+
+    int sobelX3x3(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_16S, [](cv::Mat &s, cv::Mat &d) { return ::sobelX3x3(s, d); });
+    }
+
+    int sobelY3x3(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_16S, [](cv::Mat &s, cv::Mat &d) { return ::sobelY3x3(s, d); });
+    }
+
+    int convertToUchar(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_8U, [](cv::Mat &s, cv::Mat &d) {
+            ::convertToUchar(&s, &d);
+            return SUCCESS_CODE;
+        });
+    }
+
+    int magnitude(Planes &sx, Planes &sy, Planes &dst)
+    {
+        if (sx.channels() != sy.channels())
+        {
+            return ERROR_CODE;
+        }
+
+        int k = 0;
+        return eachPlane(sx, dst, CV_8U, [&](cv::Mat &s, cv::Mat &d) { return ::magnitude(s, sy.plane(k++), d); });
+    }
+
+    int magnitudeFilter(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_8U, [](cv::Mat &s, cv::Mat &d) {
+            ::magnitudeFilter(&s, &d);
+            return SUCCESS_CODE;
+        });
+    }
+
+    int blurQuantize(Planes &src, Planes &dst, int levels)
+    {
+        return eachPlane(src, dst, CV_8U, [=](cv::Mat &s, cv::Mat &d) { return ::blurQuantize(s, d, levels); });
+    }
+
+    int negative(Planes &src, Planes &dst)
+    {
+        return eachPlane(src, dst, CV_8U, [](cv::Mat &s, cv::Mat &d) { return ::negative(s, d); });
+    }
+
+    int cartoon(Planes &src, Planes &dst, int levels, int magThreshold)
+    {
+        return eachPlane(src, dst, CV_8U, [=](cv::Mat &s, cv::Mat &d) {
+            return ::cartoon(s, d, levels, magThreshold);
+        });
+    }
+
+    // one band of the planar orientation map
+    static void orientationRows(Planes &src, cv::Mat &dst, int bins, int row_begin, int row_end)
+    {
+        int cn = src.channels();
+        std::vector<std::unique_ptr<gradient::GradientSweep>> sweeps;
+        for (int k = 0; k < cn; k++)
+        {
+            sweeps.emplace_back(new gradient::GradientSweep(src.plane(k), row_begin));
+        }
+
+        // one row of responses per channel
+        pool::PooledMat sx_rows(cn, src.cols(), CV_16SC1);
+        pool::PooledMat sy_rows(cn, src.cols(), CV_16SC1);
+        std::vector<const short *> sx(cn);
+        std::vector<const short *> sy(cn);
+        for (int k = 0; k < cn; k++)
+        {
+            sx[k] = (*sx_rows).ptr<short>(k);
+            sy[k] = (*sy_rows).ptr<short>(k);
+        }
+
+        for (int r = row_begin; r < row_end; r++)
+        {
+            for (int k = 0; k < cn; k++)
+            {
+                sweeps[k]->row(r, (*sx_rows).ptr<short>(k), (*sy_rows).ptr<short>(k));
+            }
+            gradient::orientationRowPlanar(sx.data(), sy.data(), dst.ptr<uchar>(r), src.cols(), cn, bins);
+        }
+    }
+
+    int orientation(Planes &src, cv::Mat &dst, int bins)
+    {
+        if (bins < 2 || bins > 255 || src.channels() == 0 || src.depth() != CV_8U)
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(src.rows(), src.cols(), CV_8UC1);
+        exec::forEachBand(src.rows(), [&](int row_begin, int row_end) {
+            orientationRows(src, dst, bins, row_begin, row_end);
+        });
+
+        return SUCCESS_CODE;
+    }
+}
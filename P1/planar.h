@@ -0,0 +1,216 @@
+/**
+ * Header for the planar filter mode. An interleaved BGR image is split once into one
+ * contiguous plane per channel, every filter of a chain then runs its single channel
+ * kernels over whole planes, and the result is merged back to interleaved once at the
+ * end. Within a plane neighbouring pixels are neighbouring values, so the row kernels
+ * vectorize without shuffling channels apart and a pass over one channel touches only
+ * that channel's cache lines.
+ */
+
+#ifndef P1_PLANAR
+#define P1_PLANAR
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace planar
+{
+    /**
+     * An image held as one single channel cv::Mat per channel.
+     */
+    class Planes
+    {
+        private:
+            // the planes, in channel order
+            std::vector<cv::Mat> planes;
+
+        public:
+            /**
+             * Allocates the planes. Planes which already have the requested size and
+             * depth keep their buffers, so a Planes reused across frames allocates once.
+             *
+             * @param rows the number of rows
+             * @param cols the number of cols
+             * @param depth the OpenCV depth of each plane, e.g. CV_8U
+             * @param cn the number of planes
+             */
+            void create(int rows, int cols, int depth, int cn);
+
+            /**
+             * Getter for a plane.
+             *
+             * @param k the channel
+             *
+             * @return reference to the single channel plane
+             */
+            cv::Mat& plane(int k) { return planes[k]; }
+
+            /**
+             * Getter for the number of planes.
+             *
+             * @return the number of channels
+             */
+            int channels() const { return (int) planes.size(); }
+
+            /**
+             * Getter for the number of rows.
+             *
+             * @return the number of rows, 0 if there are no planes
+             */
+            int rows() const { return planes.empty() ? 0 : planes[0].rows; }
+
+            /**
+             * Getter for the number of cols.
+             *
+             * @return the number of cols, 0 if there are no planes
+             */
+            int cols() const { return planes.empty() ? 0 : planes[0].cols; }
+
+            /**
+             * Getter for the depth of the planes.
+             *
+             * @return the OpenCV depth, -1 if there are no planes
+             */
+            int depth() const { return planes.empty() ? -1 : planes[0].depth(); }
+    };
+
+    /**
+     * Splits an interleaved image into planes.
+     *
+     * @param src reference to the CV_8U or CV_16S interleaved image
+     * @param dst the planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int split(cv::Mat &src, Planes &dst);
+
+    /**
+     * Merges planes back into an interleaved image, allocating it if needed.
+     *
+     * @param src the CV_8U or CV_16S planes
+     * @param dst reference to the interleaved image to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int merge(Planes &src, cv::Mat &dst);
+
+    /**
+     * Planar grayscale. Weights the B, G and R planes as cvtColor does for 8-bit
+     * BGR2GRAY.
+     *
+     * @param src the three uchar planes
+     * @param dst reference to the CV_8UC1 image to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int grayscale(Planes &src, cv::Mat &dst);
+
+    /**
+     * Planar blur5x5(). Each of the planar filters below allocates dst and runs the
+     * matching interleaved filter on each plane as a single channel image.
+     *
+     * @param src the uchar planes
+     * @param dst the uchar planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int blur5x5(Planes &src, Planes &dst);
+
+    /**
+     * Planar sobelX3x3().
+     *
+     * @param src the uchar planes
+     * @param dst the short planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int sobelX3x3(Planes &src, Planes &dst);
+
+    /**
+     * Planar sobelY3x3().
+     *
+     * @param src the uchar planes
+     * @param dst the short planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int sobelY3x3(Planes &src, Planes &dst);
+
+    /**
+     * Planar convertToUchar().
+     *
+     * @param src the short planes
+     * @param dst the uchar planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int convertToUchar(Planes &src, Planes &dst);
+
+    /**
+     * Planar magnitude().
+     *
+     * @param sx the short SobelX planes
+     * @param sy the short SobelY planes
+     * @param dst the uchar planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int magnitude(Planes &sx, Planes &sy, Planes &dst);
+
+    /**
+     * Planar magnitudeFilter().
+     *
+     * @param src the uchar planes
+     * @param dst the uchar planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int magnitudeFilter(Planes &src, Planes &dst);
+
+    /**
+     * Planar blurQuantize().
+     *
+     * @param src the uchar planes
+     * @param dst the uchar planes to fill
+     * @param levels the number of quantization levels
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int blurQuantize(Planes &src, Planes &dst, int levels);
+
+    /**
+     * Planar negative().
+     *
+     * @param src the uchar planes
+     * @param dst the uchar planes to fill
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int negative(Planes &src, Planes &dst);
+
+    /**
+     * Planar cartoon().
+     *
+     * @param src the uchar planes
+     * @param dst the uchar planes to fill
+     * @param levels the number of quantization levels
+     * @param magThreshold values whose gradient magnitude exceeds this are set to 0
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int cartoon(Planes &src, Planes &dst, int levels, int magThreshold);
+
+    /**
+     * Planar orientation(). The gradients of every plane are swept side by side and
+     * each pixel takes the direction of its strongest channel.
+     *
+     * @param src the uchar planes
+     * @param dst reference to the CV_8UC1 orientation map to fill
+     * @param bins the number of direction bins, 2 - 255
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int orientation(Planes &src, cv::Mat &dst, int bins);
+}
+
+#endif
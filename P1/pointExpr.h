@@ -0,0 +1,438 @@
+/**
+ * Header for composing point operations at compile time. An expression such as
+ * quantize(negative(img), 15) builds a tree of small value types instead of running
+ * anything; eval() then walks the tree once. Every operation above the leaf maps a
+ * uchar to a uchar, so the whole chain is inlined into one function, compiled into a
+ * single lookup table, and applied to each row with the vectorized table lookup in
+ * simd, straight from the leaf's row. However long the chain, the image is read once
+ * and written once, and no intermediate image is allocated.
+ *
+ * A leaf is a uchar image, the absolute value of a Sobel response, or the gradient
+ * magnitude of a pair of Sobel responses, so thresholding a magnitude also runs as one
+ * pass over the responses.
+ */
+
+#ifndef P1_POINT_EXPR
+#define P1_POINT_EXPR
+
+#include <opencv2/opencv.hpp>
+#include "exec.h"
+#include "simd.h"
+#include "gradient.h"
+#include "pointOp.h"
+
+namespace expr
+{
+    /**
+     * A uchar image at the leaf of an expression.
+     */
+    class Image
+    {
+        private:
+            // the header of the image, sharing its data, so a temporary view such as
+            // rowRange() may be passed
+            cv::Mat img;
+
+        public:
+            /**
+             * Primary constructor for the Image.
+             *
+             * @param m reference to the uchar image
+             */
+            explicit Image(const cv::Mat &m): img(m) {}
+
+            /**
+             * Getter for the leaf of the expression.
+             *
+             * @return reference to this leaf
+             */
+            const Image& leaf() const { return *this; }
+
+            /**
+             * Maps a value of the leaf through the expression, the identity for a leaf.
+             *
+             * @param v the value, 0 - 255
+             *
+             * @return the value
+             */
+            int apply(int v) const { return v; }
+
+            /**
+             * Checks the expression can be evaluated.
+             *
+             * @return true for a uchar image
+             */
+            bool valid() const { return img.depth() == CV_8U; }
+
+            /**
+             * Getter for the type of the output.
+             *
+             * @return the type of the image
+             */
+            int type() const { return img.type(); }
+
+            /**
+             * Getter for the size of the output.
+             *
+             * @return the size of the image
+             */
+            cv::Size size() const { return img.size(); }
+
+            /**
+             * Maps one row of the image through a lookup table.
+             *
+             * @param r the row
+             * @param lut pointer to the 256-entry table of the whole expression
+             * @param out pointer to the output row
+             */
+            void row(int r, const uchar *lut, uchar *out) const
+            {
+                simd::lutRow(lut, img.ptr<uchar>(r), out, img.cols * img.channels());
+            }
+    };
+
+    /**
+     * The uchar absolute value of a short image at the leaf of an expression, as
+     * convertToUchar() computes it.
+     */
+    class Absolute
+    {
+        private:
+            // the header of the short image, sharing its data
+            cv::Mat img;
+
+        public:
+            /**
+             * Primary constructor for the Absolute.
+             *
+             * @param m reference to the short image, such as a Sobel response
+             */
+            explicit Absolute(const cv::Mat &m): img(m) {}
+
+            /**
+             * Getter for the leaf of the expression.
+             *
+             * @return reference to this leaf
+             */
+            const Absolute& leaf() const { return *this; }
+
+            /**
+             * Maps a value of the leaf through the expression, the identity for a leaf.
+             *
+             * @param v the value, 0 - 255
+             *
+             * @return the value
+             */
+            int apply(int v) const { return v; }
+
+            /**
+             * Checks the expression can be evaluated.
+             *
+             * @return true for a short image
+             */
+            bool valid() const { return img.depth() == CV_16S; }
+
+            /**
+             * Getter for the type of the output.
+             *
+             * @return the uchar type with the image's channel count
+             */
+            int type() const { return CV_8UC(img.channels()); }
+
+            /**
+             * Getter for the size of the output.
+             *
+             * @return the size of the image
+             */
+            cv::Size size() const { return img.size(); }
+
+            /**
+             * Computes one row of absolute values and maps it through a lookup table.
+             *
+             * @param r the row
+             * @param lut pointer to the 256-entry table of the whole expression
+             * @param out pointer to the output row
+             */
+            void row(int r, const uchar *lut, uchar *out) const
+            {
+                int n = img.cols * img.channels();
+                simd::absRow(img.ptr<short>(r), out, n);
+                simd::lutRow(lut, out, out, n);
+            }
+    };
+
+    /**
+     * The gradient magnitude of a pair of Sobel responses at the leaf of an expression,
+     * as magnitude() computes it.
+     */
+    class Magnitude
+    {
+        private:
+            // the headers of the short SobelX and SobelY responses, sharing their data
+            cv::Mat sx;
+            cv::Mat sy;
+
+        public:
+            /**
+             * Primary constructor for the Magnitude.
+             *
+             * @param x reference to the short SobelX responses
+             * @param y reference to the short SobelY responses
+             */
+            Magnitude(const cv::Mat &x, const cv::Mat &y): sx(x), sy(y) {}
+
+            /**
+             * Getter for the leaf of the expression.
+             *
+             * @return reference to this leaf
+             */
+            const Magnitude& leaf() const { return *this; }
+
+            /**
+             * Maps a value of the leaf through the expression, the identity for a leaf.
+             *
+             * @param v the value, 0 - 255
+             *
+             * @return the value
+             */
+            int apply(int v) const { return v; }
+
+            /**
+             * Checks the expression can be evaluated.
+             *
+             * @return true for two short images of the same size and type
+             */
+            bool valid() const
+            {
+                return sx.depth() == CV_16S && sx.type() == sy.type() && sx.size() == sy.size();
+            }
+
+            /**
+             * Getter for the type of the output.
+             *
+             * @return the uchar type with the responses' channel count
+             */
+            int type() const { return CV_8UC(sx.channels()); }
+
+            /**
+             * Getter for the size of the output.
+             *
+             * @return the size of the responses
+             */
+            cv::Size size() const { return sx.size(); }
+
+            /**
+             * Computes one row of magnitude and maps it through a lookup table.
+             *
+             * @param r the row
+             * @param lut pointer to the 256-entry table of the whole expression
+             * @param out pointer to the output row
+             */
+            void row(int r, const uchar *lut, uchar *out) const
+            {
+                int n = sx.cols * sx.channels();
+                gradient::magnitudeRow(sx.ptr<short>(r), sy.ptr<short>(r), out, n);
+                simd::lutRow(lut, out, out, n);
+            }
+    };
+
+    /**
+     * A point operation applied to the values of an expression.
+     *
+     * @tparam E the type of the expression below
+     * @tparam F the type of the mapping, callable with an int in 0 - 255
+     */
+    template <typename E, typename F>
+    class Map
+    {
+        private:
+            // the expression below
+            E child;
+
+            // the mapping
+            F f;
+
+            // are the parameters of the mapping in range
+            bool ok;
+
+        public:
+            /**
+             * Primary constructor for the Map.
+             *
+             * @param e the expression below
+             * @param fn the mapping
+             * @param in_range false if the parameters of the mapping are out of range
+             */
+            Map(const E &e, F fn, bool in_range): child(e), f(fn), ok(in_range) {}
+
+            /**
+             * Getter for the leaf of the expression.
+             *
+             * @return reference to the leaf
+             */
+            decltype(auto) leaf() const { return child.leaf(); }
+
+            /**
+             * Maps a value of the leaf through the expression. Each operation narrows
+             * its result to a uchar, as a PointOp does, so the chain gives what running
+             * each operation on its own would.
+             *
+             * @param v the value, 0 - 255
+             *
+             * @return the mapped value, 0 - 255
+             */
+            int apply(int v) const { return (uchar) f(child.apply(v)); }
+
+            /**
+             * Checks the expression can be evaluated.
+             *
+             * @return true if every parameter is in range and the leaf has the right type
+             */
+            bool valid() const { return ok && child.valid(); }
+    };
+
+    /**
+     * Makes a leaf of a uchar image.
+     *
+     * @param m reference to the uchar image
+     *
+     * @return the leaf
+     */
+    inline Image wrap(const cv::Mat &m)
+    {
+        return Image(m);
+    }
+
+    /**
+     * Passes an expression through unchanged.
+     *
+     * @param e the expression
+     *
+     * @return the expression
+     */
+    template <typename E>
+    const E& wrap(const E &e)
+    {
+        return e;
+    }
+
+    /**
+     * Applies any uchar to uchar mapping to an expression.
+     *
+     * @param e a uchar image or an expression
+     * @param fn the mapping, callable with an int in 0 - 255
+     * @param in_range false if the parameters of the mapping are out of range
+     *
+     * @return the expression
+     */
+    template <typename E, typename F>
+    auto map(const E &e, F fn, bool in_range = true)
+    {
+        auto child = wrap(e);
+        return Map<decltype(child), F>(child, fn, in_range);
+    }
+
+    /**
+     * The negative of an expression, as negative() computes it.
+     *
+     * @param e a uchar image or an expression
+     *
+     * @return the expression
+     */
+    template <typename E>
+    auto negative(const E &e)
+    {
+        const pointop::PointOp &op = pointop::negativeOp();
+        return map(e, [&op](int v) { return op.lut()[v]; });
+    }
+
+    /**
+     * The (v / b) * b quantization of an expression, as blurQuantize() quantizes.
+     *
+     * @param e a uchar image or an expression
+     * @param levels the number of levels, 1 - 255
+     *
+     * @return the expression
+     */
+    template <typename E>
+    auto quantize(const E &e, int levels)
+    {
+        bool in_range = levels >= 1 && levels <= 255;
+        pointop::PointOp op = pointop::quantizeOp(in_range ? levels : 1);
+        return map(e, [op](int v) { return op.lut()[v]; }, in_range);
+    }
+
+    /**
+     * A binary threshold of an expression: 255 above the threshold, 0 otherwise.
+     *
+     * @param e a uchar image or an expression
+     * @param t the threshold
+     *
+     * @return the expression
+     */
+    template <typename E>
+    auto threshold(const E &e, int t)
+    {
+        return map(e, [t](int v) { return v > t ? 255 : 0; });
+    }
+
+    /**
+     * The uchar absolute value of a short image, as a leaf.
+     *
+     * @param m reference to the short image
+     *
+     * @return the leaf
+     */
+    inline Absolute absolute(const cv::Mat &m)
+    {
+        return Absolute(m);
+    }
+
+    /**
+     * The gradient magnitude of a pair of Sobel responses, as a leaf.
+     *
+     * @param sx reference to the short SobelX responses
+     * @param sy reference to the short SobelY responses
+     *
+     * @return the leaf
+     */
+    inline Magnitude magnitude(const cv::Mat &sx, const cv::Mat &sy)
+    {
+        return Magnitude(sx, sy);
+    }
+
+    /**
+     * Evaluates an expression in one pass, split into row bands on the exec thread
+     * pool. The operations above the leaf are compiled into one lookup table, and
+     * each row of the leaf is computed and mapped through it while still in cache.
+     *
+     * @param e a uchar image or an expression
+     * @param dst reference to the uchar destination image, allocated if needed. May be
+     *            the image at the leaf.
+     *
+     * @return 0 for success, -1 for a leaf of the wrong type or a parameter out of range
+     */
+    template <typename E>
+    int eval(const E &e, cv::Mat &dst)
+    {
+        const auto &expression = wrap(e);
+        if (!expression.valid())
+        {
+            return -1;
+        }
+
+        const auto &leaf = expression.leaf();
+        pointop::PointOp table([&expression](int v) { return expression.apply(v); });
+        cv::Size size = leaf.size();
+        dst.create(size.height, size.width, leaf.type());
+        exec::forEachBand(size.height, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                leaf.row(r, table.lut(), dst.ptr<uchar>(r));
+            }
+        });
+        return 0;
+    }
+}
+
+#endif
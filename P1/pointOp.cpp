@@ -0,0 +1,77 @@
+#include <opencv2/opencv.hpp>
+#include "pointOp.h"
+#include "simd.h"
+#include "exec.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace pointop
+{
+    // checks that dst is laid out like src with uchar values
+    static bool matchingUchar(cv::Mat &src, cv::Mat &dst)
+    {
+        return dst.depth() == CV_8U && dst.rows == src.rows && dst.cols == src.cols
+            && dst.channels() == src.channels();
+    }
+
+    int PointOp::apply(cv::Mat &src, cv::Mat &dst) const
+    {
+        if (src.depth() != CV_8U || !matchingUchar(src, dst))
+        {
+            return ERROR_CODE;
+        }
+
+        int n = src.cols * src.channels();
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                simd::lutRow(table, src.ptr<uchar>(r), dst.ptr<uchar>(r), n);
+            }
+        });
+
+        return SUCCESS_CODE;
+    }
+
+    int absToUchar(cv::Mat &src, cv::Mat &dst)
+    {
+        if (src.depth() != CV_16S || !matchingUchar(src, dst))
+        {
+            return ERROR_CODE;
+        }
+
+        int n = src.cols * src.channels();
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                simd::absRow(src.ptr<short>(r), dst.ptr<uchar>(r), n);
+            }
+        });
+
+        return SUCCESS_CODE;
+    }
+
+    PointOp quantizeOp(int levels)
+    {
+        int b = 255/levels;
+        return PointOp([b](int v) { return (v / b) * b; });
+    }
+
+    const PointOp& negativeOp()
+    {
+        static const PointOp invert([](int v) { return 255 - v; });
+        return invert;
+    }
+
+    void lutMaskRow(const uchar *lut, const uchar *src, const uchar *mag, uchar *dst, int n, int magThreshold)
+    {
+        simd::lutRow(lut, src, dst, n);
+        for (int i = 0; i < n; i++)
+        {
+            if (mag[i] > magThreshold)
+            {
+                dst[i] = 0;
+            }
+        }
+    }
+}
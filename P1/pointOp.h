@@ -0,0 +1,104 @@
+/**
+ * Header for the point-operation engine. Any mapping of a uchar value to a uchar value
+ * is compiled once into a 256-entry lookup table, which is then applied to every value
+ * of an image with the vectorized table lookup in simd. The engine also converts short
+ * images, such as the Sobel responses, to their uchar absolute values.
+ */
+
+#ifndef P1_POINT_OP
+#define P1_POINT_OP
+
+#include <opencv2/opencv.hpp>
+
+namespace pointop
+{
+    /**
+     * A uchar to uchar mapping compiled into a lookup table.
+     */
+    class PointOp
+    {
+        private:
+            // the mapped value of every uchar
+            uchar table[256];
+
+        public:
+            /**
+             * Primary constructor for the PointOp. Evaluates the mapping once for every
+             * uchar value.
+             *
+             * @param f the mapping, callable with an int in 0 - 255 and returning the
+             *          mapped value
+             */
+            template <typename F>
+            explicit PointOp(F f)
+            {
+                for (int v = 0; v < 256; v++)
+                {
+                    table[v] = (uchar) f(v);
+                }
+            }
+
+            /**
+             * Getter for the lookup table.
+             *
+             * @return pointer to the 256-entry table
+             */
+            const uchar* lut() const { return table; }
+
+            /**
+             * Maps every value of the source image into the destination image, split
+             * into row bands on the exec thread pool. src and dst may be the same image.
+             *
+             * @param src reference to the uchar source image
+             * @param dst reference to the uchar destination image, already allocated at
+             *            the size and channel count of src
+             *
+             * @return 0 for success, -1 for failure
+             */
+            int apply(cv::Mat &src, cv::Mat &dst) const;
+    };
+
+    /**
+     * Converts a short image to the uchar absolute value of each of its values,
+     * saturating at 255, split into row bands on the exec thread pool.
+     *
+     * @param src reference to the short source image
+     * @param dst reference to the uchar destination image, already allocated at the
+     *            size and channel count of src
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int absToUchar(cv::Mat &src, cv::Mat &dst);
+
+    /**
+     * Makes the (v / b) * b quantization with b = 255 / levels, which blurQuantize()
+     * and the cartoons use.
+     *
+     * @param levels the number of levels, 1 - 255
+     *
+     * @return the quantization
+     */
+    PointOp quantizeOp(int levels);
+
+    /**
+     * Getter for the 255 - v negative, which negative() and the filter graph use.
+     *
+     * @return reference to the negative, built on first use
+     */
+    const PointOp& negativeOp();
+
+    /**
+     * Maps one row through a lookup table, then draws black wherever the matching
+     * value of a magnitude row is above a threshold, as the cartoons draw their edges.
+     *
+     * @param lut pointer to the 256-entry table
+     * @param src pointer to the source row
+     * @param mag pointer to the uchar magnitude row, one value per value of src
+     * @param dst pointer to the destination row. May be src.
+     * @param n the number of values in the row
+     * @param magThreshold values whose magnitude is above this are drawn black
+     */
+    void lutMaskRow(const uchar *lut, const uchar *src, const uchar *mag, uchar *dst, int n, int magThreshold);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <opencv2/opencv.hpp>
+#include "pyramid.h"
+#include "filterTaps.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace pyramid
+{
+    cv::Size levelSize(cv::Size size, int level)
+    {
+        for (int k = 0; k < level; k++)
+        {
+            size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+        }
+        return size;
+    }
+
+    // one band of the halved image. The sweep runs the horizontal pass on every source
+    // row but the vertical pass only on the even rows.
+    template <int CN>
+    static void pyrDownRows(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end)
+    {
+        conv::SeparableSweep<BlurTaps, BlurTaps, CN, uchar, uchar, 1, uchar> sweep(src, 2 * row_begin);
+        pool::PooledMat blurred_row(1, src.cols * CN, CV_8UC1);
+        uchar *blurred = (*blurred_row).ptr<uchar>(0);
+
+        for (int r = row_begin; r < row_end; r++)
+        {
+            sweep.row(2 * r, blurred);
+
+            uchar *drow = dst.ptr<uchar>(r);
+            for (int c = 0; c < dst.cols; c++)
+            {
+                for (int ch = 0; ch < CN; ch++)
+                {
+                    drow[c * CN + ch] = blurred[2 * c * CN + ch];
+                }
+            }
+        }
+    }
+
+    int pyrDown(cv::Mat &src, cv::Mat &dst)
+    {
+        int cn = src.channels();
+        if (src.empty() || src.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4) || src.data == dst.data)
+        {
+            return ERROR_CODE;
+        }
+
+        dst.create(levelSize(src.size(), 1), src.type());
+        exec::forEachBand(dst.rows, [&](int row_begin, int row_end) {
+            if (cn == 1)
+            {
+                pyrDownRows<1>(src, dst, row_begin, row_end);
+            }
+            else if (cn == 3)
+            {
+                pyrDownRows<3>(src, dst, row_begin, row_end);
+            }
+            else
+            {
+                pyrDownRows<4>(src, dst, row_begin, row_end);
+            }
+        });
+
+        return SUCCESS_CODE;
+    }
+
+    void Pyramid::reset(cv::Mat &frame)
+    {
+        if (levels.empty())
+        {
+            levels.resize(1);
+        }
+        levels[0] = frame;
+        built = frame.empty() ? 0 : 1;
+    }
+
+    cv::Mat& Pyramid::level(int k)
+    {
+        if ((int) levels.size() <= k)
+        {
+            levels.resize(k + 1);
+        }
+
+        for (; built > 0 && built <= k; built++)
+        {
+            if (pyrDown(levels[built - 1], levels[built]) != SUCCESS_CODE)
+            {
+                break;
+            }
+        }
+
+        return built > k ? levels[k] : unbuilt;
+    }
+}
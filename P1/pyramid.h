@@ -0,0 +1,86 @@
+/**
+ * Header for the image pyramid behind the live preview mode. Each level is half the
+ * width and height of the one above it, made by the same 5x5 blur the filters use and
+ * then taking every other row and column. Levels are built on demand, each from the
+ * level above, so a frame only pays for the levels something reads, and every filter
+ * applied to the frame shares them.
+ */
+
+#ifndef P1_PYRAMID
+#define P1_PYRAMID
+
+#include <deque>
+#include <opencv2/opencv.hpp>
+
+namespace pyramid
+{
+    /**
+     * Gets the size of a pyramid level.
+     *
+     * @param size the size of the full resolution image
+     * @param level the level, 0 for full resolution
+     *
+     * @return the size of the level, rounding odd dimensions up
+     */
+    cv::Size levelSize(cv::Size size, int level);
+
+    /**
+     * Halves an image: blur5x5() followed by keeping the even rows and columns. Only
+     * the kept rows go through the vertical pass of the blur. Split into row bands on
+     * the exec thread pool.
+     *
+     * @param src reference to the uchar source image with 1, 3 or 4 channels
+     * @param dst reference to the destination image, allocated at levelSize(src, 1)
+     *
+     * @return 0 for success, -1 for failure
+     */
+    int pyrDown(cv::Mat &src, cv::Mat &dst);
+
+    /**
+     * The pyramid of one frame at a time. The level buffers are kept between frames,
+     * so a pyramid reused across a stream allocates once.
+     */
+    class Pyramid
+    {
+        private:
+            // the levels, levels[0] being the frame itself. A deque keeps references to
+            // built levels valid as deeper levels are added
+            std::deque<cv::Mat> levels;
+
+            // the number of levels built for the current frame
+            int built = 0;
+
+            // returned for a level which could not be built
+            cv::Mat unbuilt;
+
+        public:
+            /**
+             * Starts the pyramid of a new frame. No level below the frame is built until
+             * it is asked for.
+             *
+             * @param frame reference to the full resolution frame, which must stay
+             *              unchanged while the pyramid is in use
+             */
+            void reset(cv::Mat &frame);
+
+            /**
+             * Gets a level, building it and any level above it not yet built for the
+             * current frame.
+             *
+             * @param k the level, 0 for the frame itself
+             *
+             * @return reference to the level, valid until the next reset(), or an
+             *         empty image if no frame is set or the level could not be built
+             */
+            cv::Mat& level(int k);
+
+            /**
+             * Getter for the number of levels built for the current frame.
+             *
+             * @return the number of levels, including the frame itself
+             */
+            int builtLevels() const { return built; }
+    };
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "recorder.h"
+#include "bufferPool.h"
+
+// how long the encoder waits on an empty ring before checking whether to stop
+#define POP_TIMEOUT_MS 10
+
+// the digits of an image number, so the names sort in order
+#define INDEX_DIGITS 6
+
+namespace record
+{
+    // does the path end in the extension
+    static bool hasExtension(const std::string &path, const char *ext)
+    {
+        size_t len = strlen(ext);
+        return path.size() > len && path.compare(path.size() - len, len, ext) == 0;
+    }
+
+    Recorder::Recorder(const std::string &output, int capacity, bool drop, const std::string &name_prefix, double frame_rate):
+        path(output),
+        prefix(name_prefix),
+        video(hasExtension(output, ".avi") || hasExtension(output, ".mp4") || hasExtension(output, ".mkv")),
+        fps(frame_rate),
+        ring_capacity(std::max(1, capacity)),
+        // the slots take the size of the first frames pushed
+        ring(ring_capacity, cv::Size(0, 0), CV_8UC3, drop),
+        next_index(0),
+        written(0),
+        failed(0),
+        max_depth(0),
+        closed(false),
+        encoder(&Recorder::encodeLoop, this)
+    {}
+
+    Recorder::~Recorder()
+    {
+        close();
+    }
+
+    // can writeFrame() take the frame
+    static bool supported(const cv::Mat &img)
+    {
+        int cn = img.channels();
+        return !img.empty() && img.depth() == CV_8U && (cn == 1 || cn == 3 || cn == 4);
+    }
+
+    bool Recorder::push(const cv::Mat &img)
+    {
+        if (closed || !supported(img))
+        {
+            return false;
+        }
+        ring.push(img, next_index++, live::Clock::now());
+
+        int depth = ring.depth();
+        int seen = max_depth;
+        while (depth > seen && !max_depth.compare_exchange_weak(seen, depth))
+        {
+        }
+        return true;
+    }
+
+    bool Recorder::writeFrame(cv::Mat &img, long index)
+    {
+        if (!supported(img))
+        {
+            return false;
+        }
+
+        if (!video)
+        {
+            char number[32];
+            snprintf(number, sizeof(number), "%0*ld", INDEX_DIGITS, index);
+            return cv::imwrite(path + "/" + prefix + number + ".png", img);
+        }
+
+        // the writer is opened for colour, so single channel frames are expanded and
+        // the alpha of four channel frames is dropped
+        pool::PooledMat pooled_bgr(img.rows, img.cols, CV_8UC3);
+        cv::Mat &bgr = *pooled_bgr;
+        if (img.channels() == 1)
+        {
+            cv::cvtColor(img, bgr, cv::COLOR_GRAY2BGR);
+        }
+        else if (img.channels() == 4)
+        {
+            cv::cvtColor(img, bgr, cv::COLOR_BGRA2BGR);
+        }
+        else
+        {
+            img.copyTo(bgr);
+        }
+
+        if (!writer.isOpened())
+        {
+            int fourcc = hasExtension(path, ".mp4") ? cv::VideoWriter::fourcc('m', 'p', '4', 'v') : cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+            if (!writer.open(path, fourcc, fps, bgr.size(), true))
+            {
+                printf("Failed to open recording %s\n", path.c_str());
+                return false;
+            }
+            frame_size = bgr.size();
+        }
+
+        // a video keeps the size of its first frame
+        if (bgr.size() != frame_size)
+        {
+            return false;
+        }
+
+        writer.write(bgr);
+        return true;
+    }
+
+    void Recorder::encodeLoop()
+    {
+        live::Frame frame;
+        while (!ring.finished())
+        {
+            if (!ring.pop(frame, std::chrono::milliseconds(POP_TIMEOUT_MS)))
+            {
+                continue;
+            }
+
+            if (writeFrame(frame.img, frame.seq))
+            {
+                written++;
+            }
+            else
+            {
+                failed++;
+            }
+        }
+
+        writer.release();
+    }
+
+    void Recorder::close()
+    {
+        closed = true;
+        ring.close();
+        if (encoder.joinable())
+        {
+            encoder.join();
+        }
+    }
+
+    RecorderStats Recorder::stats()
+    {
+        RecorderStats s;
+        s.pushed = next_index;
+        s.written = written;
+        s.dropped = ring.droppedFrames();
+        s.failed = failed;
+        s.depth = ring.depth();
+        s.max_depth = max_depth;
+        s.capacity = ring_capacity;
+        return s;
+    }
+}
@@ -0,0 +1,162 @@
+/**
+ * Header for recording filtered frames in the background. Frames are copied into a
+ * bounded ring and a thread of the recorder's own encodes them, either into a video
+ * file or as numbered images in a directory, so a slow disk or encoder never stalls
+ * the thread producing the frames. A recorder for a live stream drops frames when its
+ * ring is full, and one for snapshots makes the caller wait instead.
+ */
+
+#ifndef P1_RECORDER
+#define P1_RECORDER
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "live.h"
+
+namespace record
+{
+    /**
+     * Counters describing a recording.
+     */
+    struct RecorderStats
+    {
+        // frames handed to the recorder
+        long pushed = 0;
+
+        // frames encoded and written
+        long written = 0;
+
+        // frames dropped because the ring was full
+        long dropped = 0;
+
+        // frames which failed to encode or write
+        long failed = 0;
+
+        // the frames waiting in the ring now, and the most that ever waited
+        int depth = 0;
+        int max_depth = 0;
+
+        // the number of frames the ring holds
+        int capacity = 0;
+    };
+
+    /**
+     * Writes frames to a video file or an image directory on a background thread.
+     */
+    class Recorder
+    {
+        private:
+            // the output video file, or the directory of the images
+            std::string path;
+
+            // the prefix of each image name, before its number
+            std::string prefix;
+
+            // is the output a video file rather than an image directory
+            bool video;
+
+            // the frame rate of the output video
+            double fps;
+
+            // the output video, opened on the first frame
+            cv::VideoWriter writer;
+
+            // the size of the output video, that of its first frame
+            cv::Size frame_size;
+
+            // the number of frames the ring holds
+            int ring_capacity;
+
+            // frames waiting to be written
+            live::FrameRing ring;
+
+            // the index of the next frame pushed, used to number the images
+            std::atomic<long> next_index;
+
+            // frames encoded and written, and frames which failed
+            std::atomic<long> written;
+            std::atomic<long> failed;
+
+            // the most frames that ever waited in the ring
+            std::atomic<int> max_depth;
+
+            // has close() been called
+            std::atomic<bool> closed;
+
+            // the encoder thread
+            std::thread encoder;
+
+            /**
+             * Main loop of the encoder thread, which runs until the ring is closed
+             * and empty.
+             */
+            void encodeLoop();
+
+            /**
+             * Writes one frame to the output.
+             *
+             * @param img the frame
+             * @param index the number of the frame among the frames pushed
+             *
+             * @return true if the frame was written
+             */
+            bool writeFrame(cv::Mat &img, long index);
+
+        public:
+            /**
+             * Primary constructor for the Recorder. Starts the encoder thread.
+             *
+             * @param output a video file, if it ends in .avi, .mp4 or .mkv, or else an
+             *               existing directory to write numbered PNG images into
+             * @param capacity the number of frames the ring holds
+             * @param drop true to drop the oldest waiting frame when the ring is full,
+             *             false to make push() wait for the encoder
+             * @param name_prefix the prefix of each image name, before its number
+             * @param frame_rate the frame rate of the output video
+             */
+            Recorder(const std::string &output, int capacity, bool drop = true,
+                const std::string &name_prefix = "frame_", double frame_rate = 30);
+
+            /**
+             * Destructor for the Recorder. Writes the frames still waiting and stops
+             * the encoder thread.
+             */
+            ~Recorder();
+
+            Recorder(const Recorder&) = delete;
+            Recorder& operator=(const Recorder&) = delete;
+
+            /**
+             * Copies a frame into the ring for the encoder thread. Frames pushed after
+             * close(), and frames of any other layout than below, are discarded.
+             *
+             * @param img the frame, 8-bit with 1, 3 or 4 channels
+             *
+             * @return true if the frame was queued
+             */
+            bool push(const cv::Mat &img);
+
+            /**
+             * Writes the frames still waiting and stops the encoder thread.
+             */
+            void close();
+
+            /**
+             * Getter for the counters.
+             *
+             * @return the counters so far
+             */
+            RecorderStats stats();
+
+            /**
+             * Getter for the output.
+             *
+             * @return the video file or image directory written to
+             */
+            const std::string& output() const { return path; }
+    };
+}
+
+#endif
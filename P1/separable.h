@@ -0,0 +1,391 @@
+/**
+ * Header for the separable convolution framework. A filter is described at compile
+ * time by its horizontal and vertical taps, its channel count and its pixel, buffer
+ * and accumulator types, so every channel count and depth gets its own specialized
+ * row loops. Both passes run through a ring of row buffers only as tall as the vertical
+ * filter, so no full-frame intermediate is ever allocated and the working set stays
+ * in cache.
+ */
+
+#ifndef P1_SEPARABLE
+#define P1_SEPARABLE
+
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "exec.h"
+#include "bufferPool.h"
+
+namespace conv
+{
+    // Enum defining how a filter treats taps which fall outside the image
+    enum Border {
+        // the tap is replaced by the center pixel
+        BORDER_CENTER,
+        // the tap is skipped
+        BORDER_ZERO
+    };
+
+    /**
+     * A 1xN filter whose weights are known at compile time. Each tap is weighted and
+     * then divided by Divisor before it is accumulated, truncating for integer pixels.
+     * Integer pixels are promoted to int and float pixels stay float.
+     */
+    template <Border B, int Divisor, int... W>
+    struct Taps
+    {
+        static constexpr int SIZE = sizeof...(W);
+        static constexpr Border BORDER = B;
+        static constexpr int WEIGHTS[SIZE] = {W...};
+
+        template <typename T>
+        inline auto operator()(T x, int k) const -> decltype(x * k)
+        {
+            return x * WEIGHTS[k] / Divisor;
+        }
+    };
+
+    /**
+     * A 1xN filter whose weights are only known at runtime, for callers such as
+     * applySobel() which take the filter as an argument.
+     */
+    template <Border B, int N>
+    struct RuntimeTaps
+    {
+        static constexpr int SIZE = N;
+        static constexpr Border BORDER = B;
+        int weights[N];
+
+        RuntimeTaps(const int *w)
+        {
+            for (int k = 0; k < N; k++)
+            {
+                weights[k] = w[k];
+            }
+        }
+
+        template <typename T>
+        inline auto operator()(T x, int k) const -> decltype(x * k)
+        {
+            return x * weights[k];
+        }
+    };
+
+    /**
+     * The per-row work of a separable filter. The default implementation is plain
+     * scalar code; a filter with a hand-vectorized kernel may specialize this
+     * template to route its rows there instead.
+     */
+    template <typename HTaps, typename VTaps, int CN, typename Acc, typename Buf, int OutDiv>
+    struct RowKernels
+    {
+        /**
+         * Applies the horizontal taps to one source row.
+         *
+         * @param h the horizontal taps
+         * @param srow pointer to the source row
+         * @param brow pointer to the row buffer to fill
+         * @param cols the number of pixels in the row
+         */
+        template <typename Src>
+        static void horizontal(const HTaps &h, const Src *srow, Buf *brow, int cols)
+        {
+            const int center_k = HTaps::SIZE / 2;
+
+            // the pixels near either end, whose taps may fall outside the row
+            int left_end = std::min(center_k, cols);
+            int right_begin = std::max(cols - center_k, left_end);
+            for (int c = 0; c < left_end; c++)
+            {
+                edgePixel(h, srow, brow, c, cols);
+            }
+            for (int c = right_begin; c < cols; c++)
+            {
+                edgePixel(h, srow, brow, c, cols);
+            }
+
+            // every tap of the interior is inside the row, so with the taps and CN known
+            // at compile time this loop carries no branches and vectorizes
+            for (int i = center_k * CN; i < right_begin * CN; i++)
+            {
+                Acc acc = 0;
+                for (int k = 0; k < HTaps::SIZE; k++)
+                {
+                    acc += h(srow[i + (k - center_k) * CN], k);
+                }
+                brow[i] = acc;
+            }
+        }
+
+        /**
+         * Applies the horizontal taps to one pixel near either end of a row.
+         *
+         * @param h the horizontal taps
+         * @param srow pointer to the source row
+         * @param brow pointer to the row buffer to fill
+         * @param c the column of the pixel
+         * @param cols the number of pixels in the row
+         */
+        template <typename Src>
+        static void edgePixel(const HTaps &h, const Src *srow, Buf *brow, int c, int cols)
+        {
+            const int center_k = HTaps::SIZE / 2;
+            for (int ch = 0; ch < CN; ch++)
+            {
+                Acc acc = 0;
+                for (int k = 0; k < HTaps::SIZE; k++)
+                {
+                    int col = c - (center_k - k);
+                    if (col < 0 || col > cols - 1)
+                    {
+                        if (HTaps::BORDER == BORDER_ZERO)
+                        {
+                            continue;
+                        }
+                        col = c;
+                    }
+
+                    acc += h(srow[col * CN + ch], k);
+                }
+                brow[c * CN + ch] = acc;
+            }
+        }
+
+        /**
+         * Applies the vertical taps to the buffered rows around one output row.
+         *
+         * @param v the vertical taps
+         * @param rows array of VTaps::SIZE row buffers centered on the output row,
+         *             nullptr for rows skipped by the border
+         * @param acc scratch accumulator row
+         * @param drow pointer to the destination row
+         * @param n the number of values in the row (cols * CN)
+         */
+        template <typename Dst>
+        static void vertical(const VTaps &v, const Buf **rows, Acc *acc, Dst *drow, int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                acc[i] = 0;
+            }
+
+            for (int k = 0; k < VTaps::SIZE; k++)
+            {
+                const Buf *brow = rows[k];
+                if (brow == nullptr)
+                {
+                    continue;
+                }
+
+                for (int i = 0; i < n; i++)
+                {
+                    acc[i] += v(brow[i], k);
+                }
+            }
+
+            for (int i = 0; i < n; i++)
+            {
+                drow[i] = acc[i] / OutDiv;
+            }
+        }
+    };
+
+    /**
+     * A top-to-bottom sweep of a separable filter over interleaved images with CN
+     * channels. The horizontal pass fills a ring of VTaps::SIZE row buffers of type
+     * Buf, and each output row is produced by the vertical pass as soon as the rows it
+     * needs are in the ring. Taps accumulate in Acc, and the vertical result is divided
+     * by OutDiv (truncating). Other kernels can pull rows from a sweep one at a time to
+     * fuse further work onto each row while it is still in cache.
+     */
+    template <typename HTaps, typename VTaps, int CN, typename Acc, typename Buf, int OutDiv, typename Src>
+    class SeparableSweep
+    {
+        private:
+            typedef RowKernels<HTaps, VTaps, CN, Acc, Buf, OutDiv> Kernels;
+
+            // the source image
+            cv::Mat &src;
+
+            // the horizontal taps
+            HTaps h;
+
+            // the vertical taps
+            VTaps v;
+
+            // the horizontal responses of the last VTaps::SIZE rows
+            pool::PooledMat ring;
+
+            // scratch accumulator row for the vertical pass
+            pool::PooledMat acc;
+
+            // the next source row to run the horizontal pass on
+            int next;
+
+        public:
+            /**
+             * Primary constructor for the SeparableSweep. The ring is primed starting
+             * from the halo rows above row_begin, so any band of rows comes out exactly
+             * as it would from a sweep over the whole image.
+             *
+             * @param s reference to the source image
+             * @param row_begin the first row the sweep will produce
+             * @param htaps the horizontal taps
+             * @param vtaps the vertical taps
+             */
+            SeparableSweep(cv::Mat &s, int row_begin, HTaps htaps = HTaps(), VTaps vtaps = VTaps()):
+                src(s),
+                h(htaps),
+                v(vtaps),
+                ring(VTaps::SIZE, s.cols * CN, cv::DataType<Buf>::type),
+                acc(1, s.cols * CN, cv::DataType<Acc>::type),
+                next(std::max(0, row_begin - VTaps::SIZE / 2))
+            {}
+
+            /**
+             * Produces the next output row. Rows must be requested in increasing order
+             * starting from row_begin.
+             *
+             * @param r the output row
+             * @param drow pointer to the destination row
+             */
+            template <typename Dst>
+            void row(int r, Dst *drow)
+            {
+                const int center_k = VTaps::SIZE / 2;
+
+                // bring the ring up to date with the last row this output row needs
+                for (; next < src.rows && next <= r + center_k; next++)
+                {
+                    Buf *brow = (*ring).ptr<Buf>(next % VTaps::SIZE);
+                    Kernels::horizontal(h, src.ptr<Src>(next), brow, src.cols);
+                }
+
+                const Buf *rows[VTaps::SIZE];
+                for (int k = 0; k < VTaps::SIZE; k++)
+                {
+                    int row = r - (center_k - k);
+                    if (row < 0 || row > src.rows - 1)
+                    {
+                        if (VTaps::BORDER == BORDER_ZERO)
+                        {
+                            rows[k] = nullptr;
+                            continue;
+                        }
+                        row = r;
+                    }
+
+                    rows[k] = (*ring).ptr<Buf>(row % VTaps::SIZE);
+                }
+
+                Kernels::vertical(v, rows, (*acc).ptr<Acc>(0), drow, src.cols * CN);
+            }
+    };
+
+    /**
+     * A separable filter over interleaved images with CN channels, run as a sweep over
+     * a range of output rows.
+     */
+    template <typename HTaps, typename VTaps, int CN, typename Acc, typename Buf = Acc, int OutDiv = 1>
+    class SeparableFilter
+    {
+        private:
+            // the horizontal taps
+            HTaps h;
+
+            // the vertical taps
+            VTaps v;
+
+        public:
+            /**
+             * Primary constructor for the SeparableFilter.
+             *
+             * @param htaps the horizontal taps
+             * @param vtaps the vertical taps
+             */
+            SeparableFilter(HTaps htaps = HTaps(), VTaps vtaps = VTaps()): h(htaps), v(vtaps) {}
+
+            /**
+             * Applies the filter to the output rows [row_begin, row_end). The destination
+             * must already be allocated at the size of the source, and may be the source
+             * itself when the whole image is filtered in one call.
+             *
+             * @param src reference to the source image
+             * @param dst reference to the destination image
+             * @param row_begin the first output row
+             * @param row_end one past the last output row
+             */
+            template <typename Src, typename Dst>
+            void apply(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end) const
+            {
+                SeparableSweep<HTaps, VTaps, CN, Acc, Buf, OutDiv, Src> sweep(src, row_begin, h, v);
+                for (int r = row_begin; r < row_end; r++)
+                {
+                    sweep.row(r, dst.ptr<Dst>(r));
+                }
+            }
+    };
+
+    /**
+     * Applies the filter to the output rows [row_begin, row_end), dispatching on the
+     * channel count of the source to the matching compile-time specialization.
+     *
+     * @return 0 for success, -1 if the channel count is not supported
+     */
+    template <typename HTaps, typename VTaps, typename Acc, typename Buf, int OutDiv, typename Src, typename Dst>
+    int separableRows(cv::Mat &src, cv::Mat &dst, int row_begin, int row_end, HTaps h, VTaps v)
+    {
+        switch (src.channels())
+        {
+            case 1:
+                SeparableFilter<HTaps, VTaps, 1, Acc, Buf, OutDiv>(h, v).template apply<Src, Dst>(
+                    src, dst, row_begin, row_end);
+                return 0;
+            case 3:
+                SeparableFilter<HTaps, VTaps, 3, Acc, Buf, OutDiv>(h, v).template apply<Src, Dst>(
+                    src, dst, row_begin, row_end);
+                return 0;
+            case 4:
+                SeparableFilter<HTaps, VTaps, 4, Acc, Buf, OutDiv>(h, v).template apply<Src, Dst>(
+                    src, dst, row_begin, row_end);
+                return 0;
+        }
+
+        return -1;
+    }
+
+    /**
+     * Applies a separable filter, dispatching once on the channel count of the source
+     * to the matching compile-time specialization. The rows are split into bands on
+     * the exec thread pool unless the filter runs in place, where a band would read
+     * rows a neighbouring band has already overwritten.
+     *
+     * @param src reference to the source image
+     * @param dst reference to the destination image
+     * @param h the horizontal taps
+     * @param v the vertical taps
+     *
+     * @return 0 for success, -1 if the channel count is not supported
+     */
+    template <typename HTaps, typename VTaps, typename Acc, typename Buf, int OutDiv, typename Src, typename Dst>
+    int separableFilter(cv::Mat &src, cv::Mat &dst, HTaps h = HTaps(), VTaps v = VTaps())
+    {
+        int cn = src.channels();
+        if (cn != 1 && cn != 3 && cn != 4)
+        {
+            return -1;
+        }
+
+        if (src.data == dst.data)
+        {
+            return separableRows<HTaps, VTaps, Acc, Buf, OutDiv, Src, Dst>(src, dst, 0, src.rows, h, v);
+        }
+
+        exec::forEachBand(src.rows, [&](int row_begin, int row_end) {
+            separableRows<HTaps, VTaps, Acc, Buf, OutDiv, Src, Dst>(src, dst, row_begin, row_end, h, v);
+        });
+
+        return 0;
+    }
+}
+
+#endif
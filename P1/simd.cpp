@@ -0,0 +1,382 @@
+#include <opencv2/opencv.hpp>
+#include "simd.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define BLUR_FILTER_SIZE 5
+
+namespace simd
+{
+    // [1, 2, 4, 2, 1] / 10 as 16-bit fixed point multipliers. For every uchar input
+    // (x * BLUR_FP[k]) >> 16 equals x * filter[k] / 10, so each tap is truncated
+    // exactly as the original integer divide was.
+    static const int BLUR_FP[BLUR_FILTER_SIZE] = {6554, 13108, 26216, 13108, 6554};
+
+    static ISA detectIsa()
+    {
+#ifdef SIMD_X86
+        if (cv::checkHardwareSupport(CV_CPU_AVX2))
+        {
+            return AVX2;
+        }
+        if (cv::checkHardwareSupport(CV_CPU_SSE2))
+        {
+            return SSE2;
+        }
+#endif
+        return SCALAR;
+    }
+
+    static ISA active_isa = detectIsa();
+
+    ISA isa()
+    {
+        return active_isa;
+    }
+
+    ISA setIsa(ISA target)
+    {
+        ISA best = detectIsa();
+        active_isa = target > best ? best : target;
+        return active_isa;
+    }
+
+    const char* isaName(ISA target)
+    {
+        if (target == AVX2)
+        {
+            return "avx2";
+        }
+        if (target == SSE2)
+        {
+            return "sse2";
+        }
+        return "scalar";
+    }
+
+    static inline uchar blurTap(uchar x, int k)
+    {
+        return (uchar) ((x * BLUR_FP[k]) >> 16);
+    }
+
+    // scalar horizontal pass over the uchar values [begin, end) of a row
+    static void blurRowHScalar(const uchar *src, uchar *dst, int cols, int cn, int begin, int end)
+    {
+        int center_k = BLUR_FILTER_SIZE / 2;
+        for (int i = begin; i < end; i++)
+        {
+            int c = i / cn;
+            uchar sum = 0;
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                int col = c - (center_k - k);
+                if (col < 0 || col > cols - 1)
+                {
+                    col = c;
+                }
+
+                sum += blurTap(src[i + (col - c) * cn], k);
+            }
+            dst[i] = sum;
+        }
+    }
+
+    // scalar vertical pass over the uchar values [begin, end) of a row
+    static void blurRowVScalar(const uchar **rows, uchar *dst, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            uchar sum = 0;
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                sum += blurTap(rows[k][i], k);
+            }
+            dst[i] = sum;
+        }
+    }
+
+    static void lutRowScalar(const uchar *lut, const uchar *src, uchar *dst, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            dst[i] = lut[src[i]];
+        }
+    }
+
+    static void absRowScalar(const short *src, uchar *dst, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            int a = abs(src[i]);
+            dst[i] = (uchar) (a > 255 ? 255 : a);
+        }
+    }
+
+#ifdef SIMD_X86
+    // returns the index of the first value not processed
+    static int blurRowHSse2(const uchar *src, uchar *dst, int cn, int begin, int end)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i fp[BLUR_FILTER_SIZE];
+        for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+        {
+            fp[k] = _mm_set1_epi16((short) BLUR_FP[k]);
+        }
+
+        int i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i lo = zero;
+            __m128i hi = zero;
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *) (src + i + (k - 2) * cn));
+                lo = _mm_add_epi16(lo, _mm_mulhi_epu16(_mm_unpacklo_epi8(v, zero), fp[k]));
+                hi = _mm_add_epi16(hi, _mm_mulhi_epu16(_mm_unpackhi_epi8(v, zero), fp[k]));
+            }
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+        }
+
+        return i;
+    }
+
+    static int blurRowVSse2(const uchar **rows, uchar *dst, int begin, int end)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i fp[BLUR_FILTER_SIZE];
+        for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+        {
+            fp[k] = _mm_set1_epi16((short) BLUR_FP[k]);
+        }
+
+        int i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i lo = zero;
+            __m128i hi = zero;
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *) (rows[k] + i));
+                lo = _mm_add_epi16(lo, _mm_mulhi_epu16(_mm_unpacklo_epi8(v, zero), fp[k]));
+                hi = _mm_add_epi16(hi, _mm_mulhi_epu16(_mm_unpackhi_epi8(v, zero), fp[k]));
+            }
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+        }
+
+        return i;
+    }
+
+    static int absRowSse2(const short *src, uchar *dst, int begin, int end)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        int i = begin;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128i hi = _mm_loadu_si128((const __m128i *) (src + i + 8));
+
+            // the saturating negate turns -32768 into 32767, which packs to 255
+            lo = _mm_max_epi16(lo, _mm_subs_epi16(zero, lo));
+            hi = _mm_max_epi16(hi, _mm_subs_epi16(zero, hi));
+            _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+        }
+
+        return i;
+    }
+
+    SIMD_TARGET_AVX2
+    static inline __m256i packAvx2(__m256i lo, __m256i hi)
+    {
+        // packus works per 128-bit lane, so restore the element order afterwards
+        return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+    }
+
+    SIMD_TARGET_AVX2
+    static int blurRowHAvx2(const uchar *src, uchar *dst, int cn, int begin, int end)
+    {
+        __m256i fp[BLUR_FILTER_SIZE];
+        for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+        {
+            fp[k] = _mm256_set1_epi16((short) BLUR_FP[k]);
+        }
+
+        int i = begin;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                const uchar *p = src + i + (k - 2) * cn;
+                __m256i vlo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) p));
+                __m256i vhi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (p + 16)));
+                lo = _mm256_add_epi16(lo, _mm256_mulhi_epu16(vlo, fp[k]));
+                hi = _mm256_add_epi16(hi, _mm256_mulhi_epu16(vhi, fp[k]));
+            }
+            _mm256_storeu_si256((__m256i *) (dst + i), packAvx2(lo, hi));
+        }
+
+        return i;
+    }
+
+    SIMD_TARGET_AVX2
+    static int blurRowVAvx2(const uchar **rows, uchar *dst, int begin, int end)
+    {
+        __m256i fp[BLUR_FILTER_SIZE];
+        for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+        {
+            fp[k] = _mm256_set1_epi16((short) BLUR_FP[k]);
+        }
+
+        int i = begin;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            for (int k = 0; k < BLUR_FILTER_SIZE; k++)
+            {
+                const uchar *p = rows[k] + i;
+                __m256i vlo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) p));
+                __m256i vhi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (p + 16)));
+                lo = _mm256_add_epi16(lo, _mm256_mulhi_epu16(vlo, fp[k]));
+                hi = _mm256_add_epi16(hi, _mm256_mulhi_epu16(vhi, fp[k]));
+            }
+            _mm256_storeu_si256((__m256i *) (dst + i), packAvx2(lo, hi));
+        }
+
+        return i;
+    }
+
+    SIMD_TARGET_AVX2
+    static int lutRowAvx2(const uchar *lut, const uchar *src, uchar *dst, int begin, int end)
+    {
+        // the table as sixteen 16-entry slices, each repeated in both 128-bit lanes
+        __m256i slices[16];
+        for (int g = 0; g < 16; g++)
+        {
+            slices[g] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (lut + g * 16)));
+        }
+
+        const __m256i step = _mm256_set1_epi8(16);
+        const __m256i bias = _mm256_set1_epi8(0x70);
+
+        int i = begin;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+            __m256i out = _mm256_setzero_si256();
+            for (int g = 0; g < 16; g++)
+            {
+                // values in slice g land on 0x70 - 0x7F and every other value saturates
+                // past 0x7F, so the shuffle picks from this slice or writes zero
+                __m256i idx = _mm256_adds_epu8(v, bias);
+                out = _mm256_or_si256(out, _mm256_shuffle_epi8(slices[g], idx));
+                v = _mm256_sub_epi8(v, step);
+            }
+            _mm256_storeu_si256((__m256i *) (dst + i), out);
+        }
+
+        return i;
+    }
+
+    SIMD_TARGET_AVX2
+    static int absRowAvx2(const short *src, uchar *dst, int begin, int end)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+
+        int i = begin;
+        for (; i + 32 <= end; i += 32)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i *) (src + i));
+            __m256i hi = _mm256_loadu_si256((const __m256i *) (src + i + 16));
+            lo = _mm256_max_epi16(lo, _mm256_subs_epi16(zero, lo));
+            hi = _mm256_max_epi16(hi, _mm256_subs_epi16(zero, hi));
+            _mm256_storeu_si256((__m256i *) (dst + i), packAvx2(lo, hi));
+        }
+
+        return i;
+    }
+#endif
+
+    void blurRowH(const uchar *src, uchar *dst, int cols, int cn)
+    {
+        int n = cols * cn;
+        int center_k = BLUR_FILTER_SIZE / 2;
+
+        // only pixels with all five taps inside the row can be vectorized
+        int begin = center_k * cn;
+        int end = (cols - center_k) * cn;
+        if (end <= begin)
+        {
+            blurRowHScalar(src, dst, cols, cn, 0, n);
+            return;
+        }
+
+        int i = begin;
+#ifdef SIMD_X86
+        if (active_isa == AVX2)
+        {
+            i = blurRowHAvx2(src, dst, cn, i, end);
+        }
+        if (active_isa >= SSE2)
+        {
+            i = blurRowHSse2(src, dst, cn, i, end);
+        }
+#endif
+
+        blurRowHScalar(src, dst, cols, cn, 0, begin);
+        blurRowHScalar(src, dst, cols, cn, i, n);
+    }
+
+    void blurRowV(const uchar **rows, uchar *dst, int n)
+    {
+        int i = 0;
+#ifdef SIMD_X86
+        if (active_isa == AVX2)
+        {
+            i = blurRowVAvx2(rows, dst, i, n);
+        }
+        if (active_isa >= SSE2)
+        {
+            i = blurRowVSse2(rows, dst, i, n);
+        }
+#endif
+
+        blurRowVScalar(rows, dst, i, n);
+    }
+
+    void lutRow(const uchar *lut, const uchar *src, uchar *dst, int n)
+    {
+        int i = 0;
+#ifdef SIMD_X86
+        if (active_isa == AVX2)
+        {
+            i = lutRowAvx2(lut, src, dst, i, n);
+        }
+#endif
+
+        lutRowScalar(lut, src, dst, i, n);
+    }
+
+    void absRow(const short *src, uchar *dst, int n)
+    {
+        int i = 0;
+#ifdef SIMD_X86
+        if (active_isa == AVX2)
+        {
+            i = absRowAvx2(src, dst, i, n);
+        }
+        if (active_isa >= SSE2)
+        {
+            i = absRowSse2(src, dst, i, n);
+        }
+#endif
+
+        absRowScalar(src, dst, i, n);
+    }
+}
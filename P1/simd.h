@@ -0,0 +1,94 @@
+/**
+ * Header for the vectorized row kernels used by the filters. Each kernel has
+ * an SSE2 and an AVX2 implementation alongside a scalar fallback which
+ * produces bit-identical output. The instruction set is selected once at
+ * runtime from the features reported by the CPU.
+ */
+
+#ifndef P1_SIMD
+#define P1_SIMD
+
+#include <opencv2/opencv.hpp>
+
+namespace simd
+{
+    // Enum defining the instruction sets a kernel may be dispatched to
+    enum ISA {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    /**
+     * Gets the instruction set the kernels are currently dispatched to. On first
+     * call this is the best instruction set supported by the CPU.
+     *
+     * @return the active instruction set
+     */
+    ISA isa();
+
+    /**
+     * Forces the kernels onto a given instruction set. Requests for an instruction
+     * set the CPU does not support fall back to the best supported one.
+     *
+     * @param target the instruction set to dispatch to
+     *
+     * @return the instruction set actually selected
+     */
+    ISA setIsa(ISA target);
+
+    /**
+     * Gets a printable name for an instruction set.
+     *
+     * @param target the instruction set
+     *
+     * @return the name of the instruction set
+     */
+    const char* isaName(ISA target);
+
+    /**
+     * Applies the horizontal pass of the [1, 2, 4, 2, 1] blur to one row of
+     * interleaved uchar pixels. Taps which fall outside the row are replaced by
+     * the center pixel.
+     *
+     * @param src pointer to the source row
+     * @param dst pointer to the destination row
+     * @param cols the number of pixels in the row
+     * @param cn the number of channels per pixel
+     */
+    void blurRowH(const uchar *src, uchar *dst, int cols, int cn);
+
+    /**
+     * Applies the vertical pass of the [1, 2, 4, 2, 1] blur to one row. The caller
+     * supplies the five source rows centered on the output row, with rows outside
+     * the image already replaced by the center row.
+     *
+     * @param rows array of five pointers to the source rows
+     * @param dst pointer to the destination row
+     * @param n the number of uchar values in the row (cols * channels)
+     */
+    void blurRowV(const uchar **rows, uchar *dst, int n);
+
+    /**
+     * Maps one row of uchar values through a 256-entry lookup table. The AVX2 path
+     * looks the table up with byte shuffles, sixteen entries at a time; byte shuffles
+     * have no SSE2 form, so SSE2 uses the scalar loop. src and dst may be the same row.
+     *
+     * @param lut pointer to the 256-entry table
+     * @param src pointer to the source row
+     * @param dst pointer to the destination row
+     * @param n the number of uchar values in the row (cols * channels)
+     */
+    void lutRow(const uchar *lut, const uchar *src, uchar *dst, int n);
+
+    /**
+     * Converts one row of shorts to uchar absolute values, saturating at 255.
+     *
+     * @param src pointer to the source row
+     * @param dst pointer to the destination row
+     * @param n the number of values in the row (cols * channels)
+     */
+    void absRow(const short *src, uchar *dst, int n);
+}
+
+#endif
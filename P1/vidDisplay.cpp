@@ -1,130 +1,327 @@
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include "filters.h"
+#include "exec.h"
+#include "live.h"
+#include "frameSource.h"
+#include "bufferPool.h"
+#include "latency.h"
+#include "incremental.h"
+#include "recorder.h"
+#include "memo.h"
 
 #define ERROR_CODE -1
 #define SUCCESS_CODE 0
+#define LIVE_RING_SIZE 3
+#define ORIENTATION_BINS 8
 
+// the deepest pyramid level the live preview may filter, 1/16 of the width
+#define MAX_PREVIEW_LEVEL 4
 
-bool save_frame(cv::Mat *frame)
+// the grid cell of the bilateral cartoon, in pixels and in luma levels
+#define BILATERAL_SIGMA_SPACE 16
+#define BILATERAL_SIGMA_RANGE 16
+
+// the cartoon's levels and edge threshold until changed with +/- and ]/[
+#define CARTOON_LEVELS 15
+#define CARTOON_MAG_THRESHOLD 15
+
+// how far one press of ]/[ moves the cartoon's edge threshold
+#define THRESHOLD_STEP 5
+
+// the tile size of incremental mode when none is given
+#define DEFAULT_INCREMENTAL_TILE 64
+
+// the frames waiting to be saved before 's' waits for the disk
+#define SNAPSHOT_QUEUE 8
+
+// the frames waiting to be recorded before the oldest is dropped
+#define RECORD_QUEUE 32
+
+// the frame rate of recorded video
+#define RECORD_FPS 30
+
+
+// saves frames in the background, named by the time of the first save and the
+// number of the save, so saves within the same second keep their own files
+record::Recorder& snapshots()
 {
-    return cv::imwrite(
-        "images/saved/" + std::to_string(std::time(0)) + ".png",
-        *frame);
+    static record::Recorder saver("images/saved", SNAPSHOT_QUEUE, false, std::to_string(std::time(0)) + "_");
+    return saver;
 }
 
-bool process_keystroke(char key, cv::Mat *frame)
+bool save_frame(cv::Mat *frame)
 {
-    if (key == 's')
+    record::Recorder &saver = snapshots();
+
+    // frames are written on the encoder thread, so a failed write is reported by the
+    // next save
+    static long failed_seen = 0;
+    long failed = saver.stats().failed;
+    if (failed > failed_seen)
     {
-        return save_frame(frame);
+        printf("Failed to write %ld saved frame(s) to %s\n", failed - failed_seen, saver.output().c_str());
+        failed_seen = failed;
     }
-    if (key == 'g')
-    {
-        cv::Mat gs_image = cv::Mat(frame->rows, frame->cols, frame->type());
-        grayscale(frame, &gs_image);
-        cv::namedWindow("Grayscale", 1);
-        cv::imshow("Grayscale", gs_image);
+    return saver.push(*frame);
+}
 
-        int key = cv::waitKey(0);
-        if (key == 's')
-        {
-            return save_frame(&gs_image);
-        }
+void print_record_stats(const record::RecorderStats &stats, const std::string &path)
+{
+    printf(
+        "Recorded %ld/%ld frames to %s, dropped %ld, failed %ld, queue depth max %d/%d\n",
+        stats.written, stats.pushed, path.c_str(), stats.dropped, stats.failed, stats.max_depth, stats.capacity);
+}
 
-        cv::destroyWindow("Grayscale");
+void print_pool_stats()
+{
+    pool::PoolStats stats = pool::framePool().stats();
+    printf(
+        "Buffer pool: %ld hits, %ld misses, %ld idle buffers (%zu bytes)\n",
+        stats.hits, stats.misses, stats.idle_buffers, stats.idle_bytes);
+}
+
+// the name a filter's latency is recorded under, nullptr for an unknown key
+const char *filter_name(char key)
+{
+    switch (key)
+    {
+        case 'g': return "grayscale";
+        case 'b': return "blur";
+        case 'x': return "sobelx";
+        case 'y': return "sobely";
+        case 'm': return "magnitude";
+        case 'l': return "quantize";
+        case 'n': return "negative";
+        case 'c': return "cartoon";
+        case 'k': return "bilateral";
+        case 'o': return "orientation";
+    }
+    return nullptr;
+}
 
+// how far a filter reads from each output pixel, for incremental mode. -1 for a
+// filter whose output depends on more than a neighbourhood of each pixel.
+int filter_halo(char key)
+{
+    switch (key)
+    {
+        case 'k':
+            return -1;
+        case 'b': case 'l': case 'c':
+            return 2;
+        case 'x': case 'y': case 'm': case 'o':
+            return 1;
+    }
+    return 0;
+}
+
+bool run_filter(char key, cv::Mat &frame, cv::Mat &dst)
+{
+    if (key == 'g')
+    {
+        grayscale(&frame, &dst);
         return true;
     }
     if (key == 'b')
     {
-        cv::Mat img = cv::Mat(frame->rows, frame->cols, frame->type(), 0.0);
-        blur5x5(*frame, img);
-        cv::namedWindow("Gaussian", 1);
-        cv::imshow("Gaussian", img);
-
-        int skey = cv::waitKey(0);
-        if (skey == 's')
-        {
-            return save_frame(&img);
-        }
-
-        cv::destroyWindow("Gaussian");
+        dst.create(frame.rows, frame.cols, frame.type());
+        return blur5x5(frame, dst) == SUCCESS_CODE;
+    }
+    if (key == 'x' || key == 'y')
+    {
+        pool::PooledMat img(frame.rows, frame.cols, CV_16SC(frame.channels()));
+        sobel(&frame, img.get(), key);
+        dst.create(frame.rows, frame.cols, frame.type());
+        convertToUchar(img.get(), &dst);
         return true;
     }
-    if (key == 'x')
+    if (key == 'm')
     {
-        cv::Mat img = cv::Mat(frame->rows, frame->cols, CV_16SC3, 0.0);
-        sobel(frame, &img, 'x');
-
-        cv::Mat cimg = cv::Mat(img.rows, img.cols, frame->type(), 0.0);
-        convertToUchar(&img, &cimg);
-
-        cv::namedWindow("Sobel X", 1);
-        cv::imshow("Sobel X", cimg);
-
-        int skey = cv::waitKey(0);
-        if (skey == 's')
-        {
-            return save_frame(&cimg);
-        }
-        cv::destroyWindow("Sobel X");
-        
+        dst.create(frame.rows, frame.cols, frame.type());
+        magnitudeFilter(&frame, &dst);
         return true;
     }
-    if (key == 'y')
+    if (key == 'l')
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        return blurQuantize(frame, dst, CARTOON_LEVELS) == SUCCESS_CODE;
+    }
+    if (key == 'n')
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        return negative(frame, dst) == SUCCESS_CODE;
+    }
+    if (key == 'c')
+    {
+        dst.create(frame.rows, frame.cols, frame.type());
+        return cartoon(frame, dst, CARTOON_LEVELS, CARTOON_MAG_THRESHOLD) == SUCCESS_CODE;
+    }
+    if (key == 'k')
     {
-        cv::Mat img = cv::Mat(frame->rows, frame->cols, CV_16SC3, 0.0);
-        sobel(frame, &img, 'y');
+        return cartoonBilateral(
+            frame, dst, CARTOON_LEVELS, CARTOON_MAG_THRESHOLD, BILATERAL_SIGMA_SPACE, BILATERAL_SIGMA_RANGE) == SUCCESS_CODE;
+    }
+    if (key == 'o')
+    {
+        return orientation(&frame, &dst, ORIENTATION_BINS) == SUCCESS_CODE;
+    }
 
-        cv::Mat cimg = cv::Mat(img.rows, img.cols, frame->type(), 0.0);
-        convertToUchar(&img, &cimg);
+    return false;
+}
 
-        cv::namedWindow("Sobel Y", 1);
-        cv::imshow("Sobel Y", cimg);
+bool apply_filter(char key, cv::Mat &frame, cv::Mat &dst)
+{
+    const char *name = filter_name(key);
+    if (!name)
+    {
+        return false;
+    }
 
-        int skey = cv::waitKey(0);
-        if (skey == 's')
+    latency::ScopedTimer timer(name);
+    return run_filter(key, frame, dst);
+}
+
+// the window of a filter which reads the paused frame's cached intermediates,
+// nullptr for any other key
+const char *cached_window(char key)
+{
+    switch (key)
+    {
+        case 'b': return "Gaussian";
+        case 'x': return "Sobel X";
+        case 'y': return "Sobel Y";
+        case 'm': return "Magnitude";
+        case 'l': return "Blur Quantize";
+        case 'c': return "Cartoon";
+        case 'k': return "Bilateral Cartoon";
+        case 'o': return "Orientation";
+    }
+    return nullptr;
+}
+
+// applies a filter to the paused frame from the blur, gradients and smoothing cached
+// for it, so each of those is computed once however many filters read it
+bool run_cached_filter(char key, memo::FrameCache &cache, cv::Mat &frame, cv::Mat &dst, int levels, int threshold)
+{
+    switch (key)
+    {
+        case 'b':
+        case 'm':
         {
-            return save_frame(&cimg);
+            cv::Mat *img = key == 'b' ? memo::blurred(cache, frame) : memo::magnitude(cache, frame);
+            if (!img)
+            {
+                return false;
+            }
+            img->copyTo(dst);
+            return true;
         }
-        cv::destroyWindow("Sobel Y");
-        return true;
+        case 'x':
+        case 'y':
+        {
+            cv::Mat *img = key == 'x' ? memo::sobelX(cache, frame) : memo::sobelY(cache, frame);
+            if (!img)
+            {
+                return false;
+            }
+            dst.create(frame.rows, frame.cols, frame.type());
+            convertToUchar(img, &dst);
+            return true;
+        }
+        case 'l':
+            return memo::blurQuantize(cache, frame, dst, levels) == SUCCESS_CODE;
+        case 'c':
+            return memo::cartoon(cache, frame, dst, levels, threshold) == SUCCESS_CODE;
+        case 'k':
+            return memo::cartoonBilateral(
+                cache, frame, dst, levels, threshold, BILATERAL_SIGMA_SPACE, BILATERAL_SIGMA_RANGE) == SUCCESS_CODE;
+        case 'o':
+            return memo::orientation(cache, frame, dst, ORIENTATION_BINS) == SUCCESS_CODE;
     }
-    if (key == 'm')
+    return false;
+}
+
+// shows a cached filter of the paused frame until a key other than another cached
+// filter or a parameter change is pressed. +/- change the levels of the cartoons and
+// quantize, and ]/[ the cartoons' edge threshold.
+bool explore_frame(char key, cv::Mat *frame, memo::FrameCache &cache)
+{
+    int levels = CARTOON_LEVELS;
+    int threshold = CARTOON_MAG_THRESHOLD;
+    cv::Mat dst;
+    for (;;)
     {
-        cv::Mat img = cv::Mat(frame->rows, frame->cols, frame->type(), 0.0);
-        magnitudeFilter(frame, &img);
-        cv::namedWindow("Magnitude", 1);
-        cv::imshow("Magnitude", img);
+        if (!run_cached_filter(key, cache, *frame, dst, levels, threshold))
+        {
+            return false;
+        }
+        const char *window = cached_window(key);
+        cv::namedWindow(window, 1);
+        cv::imshow(window, dst);
 
         int skey = cv::waitKey(0);
         if (skey == 's')
         {
-            return save_frame(&img);
+            return save_frame(&dst);
         }
-        cv::destroyWindow("Magnitude");
-        return true;
+        if (skey == '+' || skey == '-')
+        {
+            levels = std::max(1, std::min(255, levels + (skey == '+' ? 1 : -1)));
+            printf("Levels %d, edge threshold %d\n", levels, threshold);
+            continue;
+        }
+        if (skey == ']' || skey == '[')
+        {
+            threshold = std::max(0, std::min(255, threshold + (skey == ']' ? THRESHOLD_STEP : -THRESHOLD_STEP)));
+            printf("Levels %d, edge threshold %d\n", levels, threshold);
+            continue;
+        }
+
+        cv::destroyWindow(window);
+        if (!cached_window(skey))
+        {
+            return true;
+        }
+        key = skey;
     }
-    if (key == 'l')
+}
+
+bool process_keystroke(char key, cv::Mat *frame, memo::FrameCache &cache)
+{
+    if (key == 's')
+    {
+        return save_frame(frame);
+    }
+    if (cached_window(key))
+    {
+        return explore_frame(key, frame, cache);
+    }
+    if (key == 'g')
     {
-        cv::Mat dst = cv::Mat(frame->rows, frame->cols, frame->type(), 0.0);
-        blurQuantize(*frame, dst, 15);
-        cv::namedWindow("Blur Quantize", 1);
-        cv::imshow("Blur Quantize", dst);
+        pool::PooledMat pooled_gs(frame->rows, frame->cols, CV_8UC1);
+        cv::Mat &gs_image = *pooled_gs;
+        grayscale(frame, &gs_image);
+        cv::namedWindow("Grayscale", 1);
+        cv::imshow("Grayscale", gs_image);
 
-        int skey = cv::waitKey(0);
-        if (skey == 's')
+        int key = cv::waitKey(0);
+        if (key == 's')
         {
-            return save_frame(&dst);
+            return save_frame(&gs_image);
         }
 
-        cv::destroyWindow("Blur Quantize");
+        cv::destroyWindow("Grayscale");
+
         return true;
     }
     if (key == 'n')
     {
-        cv::Mat dst = cv::Mat(frame->rows, frame->cols, frame->type(), 0.0);
+        pool::PooledMat pooled_dst(frame->rows, frame->cols, frame->type());
+        cv::Mat &dst = *pooled_dst;
         negative(*frame, dst);
         cv::namedWindow("Negative", 1);
         cv::imshow("Negative", dst);
@@ -138,67 +335,307 @@ bool process_keystroke(char key, cv::Mat *frame)
         cv::destroyWindow("Negative");
         return true;
     }
-    if (key == 'c')
-    {
-        cv::Mat dst = cv::Mat(frame->rows, frame->cols, frame->type(), 0.0);
-        cartoon(*frame, dst, 15, 15);
-        cv::namedWindow("Cartoon", 1);
-        cv::imshow("Cartoon", dst);
+    return true;
+}
 
-        int skey = cv::waitKey(0);
-        if (skey == 's')
-        {
-            return save_frame(&dst);
-        }
+void print_latency_stats()
+{
+    std::vector<latency::LatencySummary> all = latency::filterLatency().summaries();
+    for (size_t i = 0; i < all.size(); i++)
+    {
+        const latency::LatencySummary &s = all[i];
+        printf(
+            "%-12s %6ld runs  p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+            s.name.c_str(), s.count, s.p50_ms, s.p90_ms, s.p99_ms, s.max_ms);
+    }
+}
 
-        cv::destroyWindow("Cartoon");
-        return true;
+// prints the filter latencies and, if a path was given, writes them there labelled
+// with the configuration of the run
+void dump_latency(const char *path, const std::string &spec, cv::Size size, int preview_level)
+{
+    print_latency_stats();
+    if (!path)
+    {
+        return;
     }
-    if (key == 'o')
+
+    latency::Labels labels = {
+        {"source", spec},
+        {"width", std::to_string(size.width)},
+        {"height", std::to_string(size.height)},
+        {"preview_level", std::to_string(preview_level)},
+        {"threads", std::to_string(exec::threads())}
+    };
+    if (latency::filterLatency().write(path, labels) != SUCCESS_CODE)
     {
-        cv::Mat dst = cv::Mat(frame->rows, frame->cols, CV_16SC3, 0.0);
-        orientation(frame, &dst);
-        cv::namedWindow("Cartoon", 1);
-        cv::imshow("Cartoon", dst);
+        printf("Failed to write latencies to %s\n", path);
+    }
+}
 
-        int skey = cv::waitKey(0);
-        if (skey == 's')
-        {
-            return save_frame(&dst);
-        }
+void print_incremental_stats(const incremental::IncrementalStats &stats)
+{
+    printf(
+        "Incremental: %ld frames (%ld in full), %.1f%% of tiles recomputed, %.1f%% of pixels with halos\n",
+        stats.frames, stats.full_frames, 100 * stats.fraction(),
+        stats.pixels > 0 ? 100.0 * stats.recomputed_pixels / stats.pixels : 0);
+}
 
-        cv::destroyWindow("Cartoon");
-        return true;
-    }
+void print_cache_stats(const memo::CacheStats &stats)
+{
+    printf("Frame cache: %ld hits, %ld misses over %ld frames\n", stats.hits, stats.misses, stats.frames);
+}
 
-    return true;
+void print_live_stats(const live::LiveStats &stats)
+{
+    printf(
+        "%ld frames in %.2f s (%.1f fps), latency mean %.2f ms max %.2f ms, dropped %ld/%ld\n",
+        stats.frames, stats.seconds, stats.seconds > 0 ? stats.frames / stats.seconds : 0,
+        stats.mean_latency_ms, stats.max_latency_ms, stats.captured_dropped, stats.filtered_dropped);
 }
 
 int main(int argc, char *argv[])
 {
-    cv::VideoCapture *cam = new cv::VideoCapture(0);
-    if (!cam->isOpened())
+    const char *usage =
+        "usage: VidDisplay [-l] [-P levels] [-s source] [-r realtime|fast] [-H filter_key] [-L latency_path] [-I tile[:threshold]] [-R record_path] [n_threads]\n"
+        "  source: camera[:index] | video:path | images:dir[:fps] | raw:path:WxH[:fps]\n";
+
+    bool live_mode = false;
+    bool headless = false;
+    char headless_key = ' ';
+    int n_threads = 0;
+    int preview_level = 0;
+    const char *latency_path = nullptr;
+    int incremental_tile = 0;
+    int incremental_threshold = 0;
+    const char *record_path = nullptr;
+    std::string spec = "camera:0";
+    source::Replay replay = source::REPLAY_REALTIME;
+    for (int i = 1; i < argc; i++)
     {
-        printf("Failed to open camera\n");
+        if (strcmp(argv[i], "-l") == 0)
+        {
+            live_mode = true;
+        }
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc && isdigit(argv[i + 1][0]))
+        {
+            // preview filters a pyramid level of each frame, each level halving the size
+            live_mode = true;
+            preview_level = atoi(argv[++i]);
+            if (preview_level > MAX_PREVIEW_LEVEL)
+            {
+                printf("%s", usage);
+                return ERROR_CODE;
+            }
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            spec = argv[++i];
+        }
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "realtime") == 0)
+            {
+                replay = source::REPLAY_REALTIME;
+            }
+            else if (strcmp(argv[i], "fast") == 0)
+            {
+                replay = source::REPLAY_FAST;
+            }
+            else
+            {
+                printf("%s", usage);
+                return ERROR_CODE;
+            }
+        }
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+        {
+            // headless runs the live pipeline with one filter and no window
+            live_mode = true;
+            headless = true;
+            headless_key = argv[++i][0];
+        }
+        else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc)
+        {
+            latency_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-I") == 0 && i + 1 < argc && isdigit(argv[i + 1][0]))
+        {
+            // incremental mode only filters the tiles of each frame which changed
+            live_mode = true;
+            incremental_tile = DEFAULT_INCREMENTAL_TILE;
+            sscanf(argv[++i], "%d:%d", &incremental_tile, &incremental_threshold);
+            if (incremental_tile < 1)
+            {
+                printf("%s", usage);
+                return ERROR_CODE;
+            }
+        }
+        else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+        {
+            // records the filtered stream in the background
+            live_mode = true;
+            record_path = argv[++i];
+        }
+        else if (isdigit(argv[i][0]))
+        {
+            n_threads = atoi(argv[i]);
+        }
+        else
+        {
+            printf("%s", usage);
+            return ERROR_CODE;
+        }
+    }
+
+    // defaults to one filter thread per hardware thread
+    exec::setThreads(n_threads);
+    printf("Filter threads: %d\n", exec::threads());
+
+    source::FrameSource *src = source::openSource(spec, replay);
+    if (!src)
+    {
+        printf("%s", usage);
+        return ERROR_CODE;
+    }
+    if (!src->isOpened())
+    {
+        printf("Failed to open source %s\n", spec.c_str());
+        delete src;
         return ERROR_CODE;
     }
 
-    cv::Size bounds(
-        (int) cam->get(cv::CAP_PROP_FRAME_WIDTH),
-        (int) cam->get(cv::CAP_PROP_FRAME_HEIGHT));
+    cv::Size bounds = src->size();
     printf("Image Size: %d %d\n", bounds.width, bounds.height);
 
+    // in incremental mode each frame goes through the selected filter tile by tile,
+    // starting over in full whenever the filter is switched
+    incremental::IncrementalFilter inc_filter(nullptr, 0, incremental_tile, incremental_threshold);
+    char inc_key = 0;
+    live::FilterFn filter = apply_filter;
+    if (incremental_tile > 0)
+    {
+        filter = [&](char key, cv::Mat &frame, cv::Mat &dst) {
+            const char *name = filter_name(key);
+            if (!name)
+            {
+                return false;
+            }
+            if (filter_halo(key) < 0)
+            {
+                return apply_filter(key, frame, dst);
+            }
+            if (key != inc_key)
+            {
+                inc_key = key;
+                inc_filter.setFilter(
+                    [key](cv::Mat &s, cv::Mat &d) { return run_filter(key, s, d) ? SUCCESS_CODE : ERROR_CODE; },
+                    filter_halo(key));
+            }
+
+            latency::ScopedTimer timer(name);
+            return inc_filter.apply(frame, dst) == SUCCESS_CODE;
+        };
+    }
+
+    // recording copies each filtered frame into a ring, and a thread of its own
+    // encodes them, so a slow disk drops recorded frames rather than live ones
+    record::Recorder *recorder = record_path ? new record::Recorder(record_path, RECORD_QUEUE, true, "frame_", RECORD_FPS) : nullptr;
+    live::SinkFn sink;
+    if (recorder)
+    {
+        sink = [recorder](const cv::Mat &img) { recorder->push(img); };
+    }
+
+    if (headless)
+    {
+        // a fast replay is a load test, so the rings block rather than drop and every
+        // run filters the same frames
+        live::LiveFilter live_filter(src, filter, LIVE_RING_SIZE, preview_level, replay != source::REPLAY_FAST);
+        live_filter.setSink(sink);
+        print_live_stats(live_filter.runHeadless(headless_key));
+
+        dump_latency(latency_path, spec, bounds, preview_level);
+        if (incremental_tile > 0)
+        {
+            print_incremental_stats(inc_filter.stats());
+        }
+        if (recorder)
+        {
+            recorder->close();
+            print_record_stats(recorder->stats(), recorder->output());
+            delete recorder;
+        }
+        print_pool_stats();
+        delete src;
+        return SUCCESS_CODE;
+    }
+
     cv::namedWindow("Video", 1);
+
+    if (live_mode)
+    {
+        live::LiveFilter live_filter(src, filter, LIVE_RING_SIZE, preview_level);
+        live_filter.setSink(sink);
+        // full resolution saves run on this thread while the filter thread runs, so
+        // they go through the stateless filters rather than the incremental tile cache
+        live_filter.setSaveFilter(apply_filter);
+        if (incremental_tile > 0 || recorder)
+        {
+            live_filter.setStatus([&]() {
+                std::string line;
+                char text[96];
+                if (incremental_tile > 0)
+                {
+                    snprintf(text, sizeof(text), "recomputed %.0f%% of tiles", 100 * inc_filter.stats().last_fraction);
+                    line += text;
+                }
+                if (recorder)
+                {
+                    record::RecorderStats stats = recorder->stats();
+                    snprintf(
+                        text, sizeof(text), "%srecording queue %d/%d  dropped %ld",
+                        line.empty() ? "" : "  ", stats.depth, stats.capacity, stats.dropped);
+                    line += text;
+                }
+                return line;
+            });
+        }
+        live_filter.run(save_frame);
+
+        dump_latency(latency_path, spec, bounds, preview_level);
+        if (incremental_tile > 0)
+        {
+            print_incremental_stats(inc_filter.stats());
+        }
+        if (recorder)
+        {
+            recorder->close();
+            print_record_stats(recorder->stats(), recorder->output());
+            delete recorder;
+        }
+        print_pool_stats();
+        delete src;
+        return SUCCESS_CODE;
+    }
+
+    // the blur and gradients of the paused frame, kept while filters are switched and
+    // tweaked, and dropped when the next frame is read
+    memo::FrameCache cache;
+    long frame_id = 0;
+
     cv::Mat frame;
+    double timestamp_ms;
 
     for(;;)
     {
-        *cam >> frame;
-        if (frame.empty())
+        if (!src->read(frame, &timestamp_ms))
         {
             printf("Frame is empty\n");
             break;
         }
+        cache.setFrame(frame_id++);
 
         // in named window "Video", show the frame
         cv::imshow("Video", frame);
@@ -209,13 +646,15 @@ int main(int argc, char *argv[])
             break;
         }
 
-        bool success = process_keystroke(key, &frame);
+        bool success = process_keystroke(key, &frame, cache);
         if (!success)
         {
             printf("Failed to process keystroke\n");
         }
     }
 
-    delete cam;
+    print_cache_stats(cache.stats());
+    print_pool_stats();
+    delete src;
     return SUCCESS_CODE;
-}
\ No newline at end of file
+}
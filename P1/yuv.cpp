@@ -0,0 +1,186 @@
+#include <opencv2/opencv.hpp>
+#include "yuv.h"
+#include "filters.h"
+#include "exec.h"
+#include "bufferPool.h"
+
+#define ERROR_CODE -1
+#define SUCCESS_CODE 0
+
+namespace yuv
+{
+    int parseFormat(const std::string &name, Format *format)
+    {
+        if (name == "i420")
+        {
+            *format = FORMAT_I420;
+        }
+        else if (name == "nv12")
+        {
+            *format = FORMAT_NV12;
+        }
+        else if (name == "yuyv")
+        {
+            *format = FORMAT_YUYV;
+        }
+        else if (name == "uyvy")
+        {
+            *format = FORMAT_UYVY;
+        }
+        else
+        {
+            return ERROR_CODE;
+        }
+        return SUCCESS_CODE;
+    }
+
+    static bool isPlanar(Format format)
+    {
+        return format == FORMAT_I420 || format == FORMAT_NV12;
+    }
+
+    int bufferLayout(Format format, cv::Size size, cv::Size *buffer_size, int *type)
+    {
+        // chroma is shared by pairs of columns, and in the planar formats by pairs
+        // of rows too
+        if (size.width <= 0 || size.height <= 0 || size.width % 2 != 0 || size.height % 2 != 0)
+        {
+            return ERROR_CODE;
+        }
+
+        if (isPlanar(format))
+        {
+            *buffer_size = cv::Size(size.width, size.height * 3 / 2);
+            *type = CV_8UC1;
+        }
+        else
+        {
+            *buffer_size = size;
+            *type = CV_8UC2;
+        }
+        return SUCCESS_CODE;
+    }
+
+    // the size of the frame held in src, or an empty size if src holds no frame of
+    // the format
+    static cv::Size frameSize(cv::Mat &src, Format format)
+    {
+        if (isPlanar(format))
+        {
+            if (src.type() != CV_8UC1 || src.rows % 3 != 0 || src.rows * 2 / 3 % 2 != 0 || src.cols % 2 != 0)
+            {
+                return cv::Size();
+            }
+            return cv::Size(src.cols, src.rows * 2 / 3);
+        }
+
+        if (src.type() != CV_8UC2 || src.cols % 2 != 0)
+        {
+            return cv::Size();
+        }
+        return src.size();
+    }
+
+    int luma(cv::Mat &src, Format format, cv::Mat &y)
+    {
+        cv::Size size = frameSize(src, format);
+        if (size.area() == 0)
+        {
+            return ERROR_CODE;
+        }
+
+        // the Y plane is the top rows of a planar frame
+        if (isPlanar(format))
+        {
+            y = src.rowRange(0, size.height);
+            return SUCCESS_CODE;
+        }
+
+        int offset = format == FORMAT_YUYV ? 0 : 1;
+        y.create(size, CV_8UC1);
+        exec::forEachBand(size.height, [&](int row_begin, int row_end) {
+            for (int r = row_begin; r < row_end; r++)
+            {
+                const uchar *srow = src.ptr<uchar>(r) + offset;
+                uchar *yrow = y.ptr<uchar>(r);
+                for (int c = 0; c < size.width; c++)
+                {
+                    yrow[c] = srow[2 * c];
+                }
+            }
+        });
+        return SUCCESS_CODE;
+    }
+
+    int grayscale(cv::Mat &src, Format format, cv::Mat &dst)
+    {
+        return luma(src, format, dst);
+    }
+
+    // runs a filter on the luma of a frame: the Y plane itself for the planar
+    // formats, gathered into a pooled buffer for the packed formats
+    template <typename F>
+    static int onLuma(cv::Mat &src, Format format, F filter)
+    {
+        cv::Size size = frameSize(src, format);
+        if (size.area() == 0)
+        {
+            return ERROR_CODE;
+        }
+
+        if (isPlanar(format))
+        {
+            cv::Mat y;
+            luma(src, format, y);
+            return filter(y);
+        }
+
+        pool::PooledMat pooled_y(size.height, size.width, CV_8UC1);
+        luma(src, format, *pooled_y);
+        return filter(*pooled_y);
+    }
+
+    int sobelX3x3(cv::Mat &src, Format format, cv::Mat &dst)
+    {
+        return onLuma(src, format, [&](cv::Mat &y) { return ::sobelX3x3(y, dst); });
+    }
+
+    int sobelY3x3(cv::Mat &src, Format format, cv::Mat &dst)
+    {
+        return onLuma(src, format, [&](cv::Mat &y) { return ::sobelY3x3(y, dst); });
+    }
+
+    int magnitudeFilter(cv::Mat &src, Format format, cv::Mat &dst)
+    {
+        return onLuma(src, format, [&](cv::Mat &y) {
+            dst.create(y.rows, y.cols, CV_8UC1);
+            ::magnitudeFilter(&y, &dst);
+            return SUCCESS_CODE;
+        });
+    }
+
+    int toBgr(cv::Mat &src, Format format, cv::Mat &dst)
+    {
+        if (frameSize(src, format).area() == 0)
+        {
+            return ERROR_CODE;
+        }
+
+        switch (format)
+        {
+            case FORMAT_I420:
+                cv::cvtColor(src, dst, cv::COLOR_YUV2BGR_I420);
+                break;
+            case FORMAT_NV12:
+                cv::cvtColor(src, dst, cv::COLOR_YUV2BGR_NV12);
+                break;
+            case FORMAT_YUYV:
+                cv::cvtColor(src, dst, cv::COLOR_YUV2BGR_YUYV);
+                break;
+            case FORMAT_UYVY:
+                cv::cvtColor(src, dst, cv::COLOR_YUV2BGR_UYVY);
+                break;
+        }
+        return SUCCESS_CODE;
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * Header for filtering YUV frames as they come from a camera or a raw .yuv file,
+ * without converting them to BGR first. Grayscale, Sobel and gradient magnitude only
+ * read luma, which a YUV frame already holds: in the planar formats the Y plane is the
+ * top rows of the buffer, so it is used in place, and in the packed formats every
+ * other byte is luma, so it is gathered in one pass. Either way is far less work than
+ * building three BGR channels only to mix them back down to one.
+ *
+ * Frames are held the way OpenCV's cvtColor expects them: the planar formats as a
+ * CV_8UC1 Mat of rows * 3 / 2 rows, the Y plane followed by the chroma, and the packed
+ * formats as a CV_8UC2 Mat of the frame's size.
+ */
+
+#ifndef P1_YUV
+#define P1_YUV
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+namespace yuv
+{
+    // Enum defining the layout of a YUV frame
+    enum Format {
+        // planar: the Y plane, then the U plane and the V plane at half size
+        FORMAT_I420,
+        // planar: the Y plane, then one plane of interleaved U and V at half size
+        FORMAT_NV12,
+        // packed: Y0 U Y1 V for each pair of pixels
+        FORMAT_YUYV,
+        // packed: U Y0 V Y1 for each pair of pixels
+        FORMAT_UYVY
+    };
+
+    /**
+     * Parses a format name.
+     *
+     * @param name one of i420, nv12, yuyv or uyvy
+     * @param format set to the format
+     *
+     * @return 0 for success, -1 for an unknown name
+     */
+    int parseFormat(const std::string &name, Format *format);
+
+    /**
+     * Gets the Mat a frame of a format is held in.
+     *
+     * @param format the format of the frame
+     * @param size the size of the frame in pixels, with an even width and height
+     * @param buffer_size set to the size of the Mat
+     * @param type set to the type of the Mat
+     *
+     * @return 0 for success, -1 for an odd width or height
+     */
+    int bufferLayout(Format format, cv::Size size, cv::Size *buffer_size, int *type);
+
+    /**
+     * Gets the luma of a frame. For the planar formats y becomes a view of the Y
+     * plane, sharing the frame's memory; for the packed formats the luma is copied
+     * into y, allocated if needed.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param y reference to the luma, CV_8UC1 of the frame's size
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int luma(cv::Mat &src, Format format, cv::Mat &y);
+
+    /**
+     * The grayscale filter of a YUV frame, which is its luma: a view of the Y plane
+     * for the planar formats.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param dst reference to the CV_8UC1 destination image
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int grayscale(cv::Mat &src, Format format, cv::Mat &dst);
+
+    /**
+     * Applies the 3x3 SobelX filter to the luma of a YUV frame.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param dst reference to the CV_16SC1 destination image, allocated if needed
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int sobelX3x3(cv::Mat &src, Format format, cv::Mat &dst);
+
+    /**
+     * Applies the 3x3 SobelY filter to the luma of a YUV frame.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param dst reference to the CV_16SC1 destination image, allocated if needed
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int sobelY3x3(cv::Mat &src, Format format, cv::Mat &dst);
+
+    /**
+     * Computes the gradient magnitude of the luma of a YUV frame.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param dst reference to the CV_8UC1 destination image, allocated if needed
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int magnitudeFilter(cv::Mat &src, Format format, cv::Mat &dst);
+
+    /**
+     * Converts a YUV frame to BGR, for the filters which need color.
+     *
+     * @param src reference to the frame
+     * @param format the format of the frame
+     * @param dst reference to the CV_8UC3 destination image
+     *
+     * @return 0 for success, -1 if src does not hold a frame of the format
+     */
+    int toBgr(cv::Mat &src, Format format, cv::Mat &dst);
+}
+
+#endif